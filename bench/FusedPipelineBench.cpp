@@ -0,0 +1,148 @@
+/*
+Fused vs. unfused per-body update stages.
+
+Build with -DGRAVITYSIM_BUILD_BENCHMARKS=ON, then:
+./FusedPipelineBench [bodies] [steps]
+
+Gravity is precomputed once (random accelerations) so that only the
+memory-bound stages are timed. Both variants do the same work, including
+resolving a fixed list of colliding pairs (1% of the bodies): the unfused
+variant streams the body array once per stage group with the collisions
+between the clamp and the drift, as PhysicsEngine::update used to; the
+fused variant streams it once, holds the colliding bodies back from the
+drift and drifts them after the collisions, as update does now.
+
+The traffic figures are a model (every sweep reads and writes the whole
+body array once), not a measurement; only the times are measured.
+*/
+#include "UpdateStages.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <utility>
+#include <vector>
+
+using Body = PhysicsEngine::Body;
+
+// Pushes an overlapping pair apart and removes their approach speed
+static void resolvePair(std::vector<Body>& bodies, std::uint32_t i, std::uint32_t j, float minDist) {
+    glm::vec3 diff = bodies[i].position - bodies[j].position;
+    float dist = glm::length(diff);
+    if (dist >= minDist || dist <= 0.0f) return;
+    glm::vec3 normal = diff / dist;
+    bodies[i].position += normal * (0.5f * (minDist - dist));
+    bodies[j].position -= normal * (0.5f * (minDist - dist));
+    float approach = glm::dot(bodies[i].velocity - bodies[j].velocity, normal);
+    if (approach < 0.0f) {
+        bodies[i].velocity -= normal * approach;
+        bodies[j].velocity += normal * approach;
+    }
+}
+
+template <class Fn>
+static double bestSeconds(int steps, Fn&& fn) {
+    double best = 1e30;
+    for (int s = 0; s < steps; ++s) {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+int main(int argc, char** argv) {
+    const size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : (1u << 20);
+    const int steps = argc > 2 ? std::atoi(argv[2]) : 20;
+    const float dt = 0.016f;
+
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> coord(-10.0f, 10.0f);
+    std::uniform_real_distribution<float> small(-0.5f, 0.5f);
+    std::vector<Body> bodies(count);
+    std::vector<glm::vec3> accelerations(count);
+    for (size_t i = 0; i < count; ++i) {
+        bodies[i] = {glm::vec3(coord(rng), 0.0f, coord(rng)), glm::vec3(small(rng), 0.0f, small(rng)), 1.0f};
+        accelerations[i] = glm::vec3(small(rng), 0.0f, small(rng));
+    }
+    bodies[0] = {glm::vec3(0.0f), glm::vec3(0.0f), 20.0f};
+
+    // Each pair starts out overlapping: body j sits just beside body i
+    const float minDist = 0.1f;
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> pairs;
+    for (std::uint32_t i = 1; i + 1 < count && pairs.size() < count / 200; i += 200) {
+        bodies[i + 1].position = bodies[i].position + glm::vec3(0.5f * minDist, 0.0f, 0.0f);
+        pairs.emplace_back(i, i + 1);
+    }
+    std::vector<std::uint8_t> deferred(count, 0);
+
+    UpdateStages::Kick kick{accelerations.data(), dt};
+    UpdateStages::Damping damping{0.999f};
+    UpdateStages::Boundary boundary{12.0f};
+    UpdateStages::VelocityClamp clamp{1.2f};
+    UpdateStages::Drift drift{dt};
+    UpdateStages::Drift deferredDrift{dt, deferred.data()};
+    auto correction = [&]() {
+        return UpdateStages::OrbitalCorrection{bodies[0].position, bodies[0].mass, 0.02f};
+    };
+
+    std::vector<Body> initial = bodies;
+    double unfused = bestSeconds(steps, [&]() {
+        UpdateStages::parallelSweep(bodies, correction());
+        UpdateStages::parallelSweep(bodies, kick, damping, boundary, clamp);
+        for (const auto& pair : pairs) {
+            resolvePair(bodies, pair.first, pair.second, minDist);
+        }
+        UpdateStages::parallelSweep(bodies, drift);
+    });
+    const std::vector<Body> unfusedResult = bodies;
+
+    bodies = initial;
+    double fused = bestSeconds(steps, [&]() {
+        for (const auto& pair : pairs) {
+            deferred[pair.first] = deferred[pair.second] = 1;
+        }
+        UpdateStages::parallelSweep(bodies, correction(), kick, damping, boundary, clamp, deferredDrift);
+        for (const auto& pair : pairs) {
+            resolvePair(bodies, pair.first, pair.second, minDist);
+        }
+        for (const auto& pair : pairs) {
+            for (std::uint32_t i : {pair.first, pair.second}) {
+                if (deferred[i]) {
+                    drift(bodies[i], i);
+                    deferred[i] = 0;
+                }
+            }
+        }
+    });
+    // The two orders must agree, or the comparison is not like for like
+    size_t mismatches = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (bodies[i].position != unfusedResult[i].position || bodies[i].velocity != unfusedResult[i].velocity) {
+            ++mismatches;
+        }
+    }
+
+    // Traffic model: every sweep reads and writes the whole body array and
+    // the kick also reads the accelerations; the pair work is negligible
+    const double bodyBytes = static_cast<double>(sizeof(Body)) * count * 2.0;
+    const double accelBytes = static_cast<double>(sizeof(glm::vec3)) * count;
+    const double unfusedBytes = 3.0 * bodyBytes + accelBytes;
+    const double fusedBytes = bodyBytes + accelBytes;
+
+    std::cout << "Bodies: " << count << ", colliding pairs: " << pairs.size()
+              << ", threads: " << TaskScheduler::instance().getThreadCount() << std::endl;
+    std::cout << "Unfused (3 sweeps): " << unfused * 1000.0 << " ms/step, model "
+              << unfusedBytes / 1e6 << " MB -> " << unfusedBytes / unfused / 1e9 << " GB/s" << std::endl;
+    std::cout << "Fused   (1 sweep):  " << fused * 1000.0 << " ms/step, model "
+              << fusedBytes / 1e6 << " MB -> " << fusedBytes / fused / 1e9 << " GB/s" << std::endl;
+    std::cout << "Measured speedup " << unfused / fused << "x; modelled traffic saved "
+              << (unfusedBytes - fusedBytes) / 1e6 << " MB/step (" << 100.0 * (1.0 - fusedBytes / unfusedBytes)
+              << "%, an estimate, not measured)" << std::endl;
+    if (mismatches > 0) {
+        std::cout << "Warning: " << mismatches << " bodies differ between the two variants" << std::endl;
+    }
+    return 0;
+}
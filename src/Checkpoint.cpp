@@ -0,0 +1,278 @@
+#include "Checkpoint.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <type_traits>
+#include <vector>
+
+namespace {
+    using Body = PhysicsEngine::Body;
+    using Slot = SlotMap::Slot;
+    static_assert(std::is_trivially_copyable<Body>::value, "bodies are saved as raw bytes");
+    static_assert(std::is_trivially_copyable<Slot>::value, "slots are saved as raw bytes");
+
+    const char magic[8] = {'G', 'S', 'I', 'M', 'C', 'K', 'P', 'T'};
+    const std::uint32_t byteOrderMark = 0x01020304u;
+
+    // File layout: Header, LawRecord (from version 2), fieldCount FieldRecords,
+    // slotCount slots, bodyCount bodies
+    struct Header {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t byteOrder;        // byteOrderMark as written by the saving machine
+        std::uint32_t bodyBytes;        // sizeof(Body) and sizeof(Slot) when saved
+        std::uint32_t slotBytes;
+        std::uint64_t bodyCount;
+        std::uint64_t slotCount;
+        std::uint64_t stepCount;
+        double time;
+        std::uint64_t randomState;
+        std::uint64_t groupSize;
+        std::uint32_t freeHead;
+        std::uint32_t forceSolver;
+        float openingAngle;
+        float gravityConstant;
+        float damping;
+        float maxVelocity;
+        float minDistance;
+        float boundaryRadius;
+        float neighbourSkin;
+        float periodicBoxSize;
+        std::uint32_t flags;            // orbitalCorrection, continuousCollisions
+        std::uint32_t collisionMode;
+        std::uint32_t fieldCount;
+        float dualOpeningAngle;         // 0 in files from before it was saved: use the default
+    };
+    static_assert(sizeof(Header) == 128, "the header layout is part of the format");
+
+    struct LawRecord {
+        std::uint32_t kind;             // ForceLaw::Kind, never Custom
+        float parameters[3];            // ForceLaw::getParameters(), zero padded
+    };
+    static_assert(sizeof(LawRecord) == 16, "the law layout is part of the format");
+    static_assert(ForceLaw::maxParameters <= 3, "LawRecord holds every law parameter");
+
+    const std::uint32_t orbitalCorrectionFlag = 1u << 0;
+    const std::uint32_t continuousCollisionsFlag = 1u << 1;
+
+    struct FieldRecord {
+        char type[16];                  // zero padded
+        float center[3];
+        float acceleration[3];
+        float mass;
+        float scaleRadius;
+        float stiffness;
+        std::uint32_t reserved;
+    };
+    static_assert(sizeof(FieldRecord) == 56, "the field layout is part of the format");
+
+    FieldRecord packField(const ExternalFieldConfig& field) {
+        FieldRecord record;
+        std::memset(&record, 0, sizeof(record));
+        std::memcpy(record.type, field.type.data(), std::min(field.type.size(), sizeof(record.type) - 1));
+        for (int k = 0; k < 3; ++k) {
+            record.center[k] = field.center[k];
+            record.acceleration[k] = field.acceleration[k];
+        }
+        record.mass = field.mass;
+        record.scaleRadius = field.scaleRadius;
+        record.stiffness = field.stiffness;
+        return record;
+    }
+
+    ExternalFieldConfig unpackField(const FieldRecord& record) {
+        ExternalFieldConfig field;
+        field.type.assign(record.type, std::find(record.type, record.type + sizeof(record.type), '\0'));
+        for (int k = 0; k < 3; ++k) {
+            field.center[k] = record.center[k];
+            field.acceleration[k] = record.acceleration[k];
+        }
+        field.mass = record.mass;
+        field.scaleRadius = record.scaleRadius;
+        field.stiffness = record.stiffness;
+        return field;
+    }
+}
+
+bool Checkpoint::save(const std::string& filename, const PhysicsEngine& engine) {
+    const PhysicsConfig& config = engine.config;
+    const std::vector<Slot>& slots = engine.bodySlots.getSlots();
+    for (const auto& field : config.externalFields) {
+        if (field.type.size() >= sizeof(FieldRecord::type)) {
+            std::cerr << "Cannot checkpoint external field type " << field.type << std::endl;
+            return false;
+        }
+    }
+    // Physics that exists only as code would not come back on load
+    if (engine.forceLaw.getKind() == ForceLaw::Kind::Custom) {
+        std::cerr << "Cannot checkpoint a custom force law; use one of ForceLaws" << std::endl;
+        return false;
+    }
+    if (engine.customExternalField) {
+        std::cerr << "Cannot checkpoint an external field set with setExternalField; "
+                  << "describe it in config.externalFields" << std::endl;
+        return false;
+    }
+
+    Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    header.byteOrder = byteOrderMark;
+    header.bodyBytes = sizeof(Body);
+    header.slotBytes = sizeof(Slot);
+    header.bodyCount = engine.bodies.size();
+    header.slotCount = slots.size();
+    header.stepCount = engine.stepCount;
+    header.time = engine.time;
+    header.randomState = engine.random.state;
+    header.groupSize = engine.tree.getGroupSize();
+    header.freeHead = engine.bodySlots.getFreeHead();
+    header.forceSolver = static_cast<std::uint32_t>(engine.forceSolver);
+    header.openingAngle = engine.tree.getOpeningAngle();
+    header.dualOpeningAngle = engine.tree.getDualOpeningAngle();
+    header.gravityConstant = config.gravityConstant;
+    header.damping = config.damping;
+    header.maxVelocity = config.maxVelocity;
+    header.minDistance = config.minDistance;
+    header.boundaryRadius = config.boundaryRadius;
+    header.neighbourSkin = config.neighbourSkin;
+    header.periodicBoxSize = config.periodicBoxSize;
+    header.flags = (config.orbitalCorrection ? orbitalCorrectionFlag : 0) |
+                   (config.continuousCollisions ? continuousCollisionsFlag : 0);
+    header.collisionMode = static_cast<std::uint32_t>(config.collisionMode);
+    header.fieldCount = static_cast<std::uint32_t>(config.externalFields.size());
+
+    LawRecord law;
+    std::memset(&law, 0, sizeof(law));
+    law.kind = static_cast<std::uint32_t>(engine.forceLaw.getKind());
+    std::copy(engine.forceLaw.getParameters(), engine.forceLaw.getParameters() + ForceLaw::maxParameters,
+              law.parameters);
+
+    std::vector<FieldRecord> fields;
+    for (const auto& field : config.externalFields) {
+        fields.push_back(packField(field));
+    }
+
+    const std::string partial = filename + ".partial";
+    {
+        std::ofstream out(partial, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            std::cerr << "Failed to open checkpoint file: " << partial << std::endl;
+            return false;
+        }
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(&law), sizeof(law));
+        out.write(reinterpret_cast<const char*>(fields.data()), fields.size() * sizeof(FieldRecord));
+        out.write(reinterpret_cast<const char*>(slots.data()), slots.size() * sizeof(Slot));
+        out.write(reinterpret_cast<const char*>(engine.bodies.data()), engine.bodies.size() * sizeof(Body));
+        out.flush();
+        if (!out) {
+            std::cerr << "Failed to write checkpoint file: " << partial << std::endl;
+            out.close();
+            std::remove(partial.c_str());
+            return false;
+        }
+    }
+    if (std::rename(partial.c_str(), filename.c_str()) != 0) {
+        std::cerr << "Failed to move checkpoint into place: " << filename << std::endl;
+        std::remove(partial.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool Checkpoint::load(const std::string& filename, PhysicsEngine& engine) {
+    std::ifstream in(filename, std::ios::binary | std::ios::ate);
+    if (!in) {
+        std::cerr << "Failed to open checkpoint file: " << filename << std::endl;
+        return false;
+    }
+    const std::uint64_t fileSize = static_cast<std::uint64_t>(in.tellg());
+    in.seekg(0);
+
+    Header header;
+    if (fileSize < sizeof(header) || !in.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, magic, sizeof(magic)) != 0) {
+        std::cerr << "Not a checkpoint file: " << filename << std::endl;
+        return false;
+    }
+    if (header.version > version) {
+        std::cerr << "Checkpoint " << filename << " has format version " << header.version
+                  << ", newer than the supported version " << version << std::endl;
+        return false;
+    }
+    if (header.byteOrder != byteOrderMark || header.bodyBytes != sizeof(Body) || header.slotBytes != sizeof(Slot)) {
+        std::cerr << "Checkpoint " << filename << " was written on a machine with a different data layout" << std::endl;
+        return false;
+    }
+    // Version 1 files predate saved laws and always ran the default one
+    ForceLaw forceLaw;
+    if (header.version >= 2) {
+        LawRecord law;
+        if (fileSize < sizeof(header) + sizeof(law) || !in.read(reinterpret_cast<char*>(&law), sizeof(law)) ||
+            !ForceLaw::fromParameters(static_cast<ForceLaw::Kind>(law.kind), law.parameters, forceLaw)) {
+            std::cerr << "Checkpoint " << filename << " is truncated or corrupt" << std::endl;
+            return false;
+        }
+    }
+    // The counts must account for the file exactly; this also rules out
+    // absurd sizes before anything is allocated
+    const std::uint64_t payload = fileSize - static_cast<std::uint64_t>(in.tellg());
+    const std::uint64_t fieldBytes = std::uint64_t(header.fieldCount) * sizeof(FieldRecord);
+    if (header.slotCount > payload / sizeof(Slot) || header.bodyCount > payload / sizeof(Body) ||
+        fieldBytes + header.slotCount * sizeof(Slot) + header.bodyCount * sizeof(Body) != payload ||
+        header.forceSolver > static_cast<std::uint32_t>(PhysicsEngine::ForceSolver::DualTree) ||
+        header.collisionMode > static_cast<std::uint32_t>(CollisionMode::Merge)) {
+        std::cerr << "Checkpoint " << filename << " is truncated or corrupt" << std::endl;
+        return false;
+    }
+
+    std::vector<FieldRecord> fields(header.fieldCount);
+    std::vector<Slot> slots(header.slotCount);
+    std::vector<Body> bodies(header.bodyCount);
+    in.read(reinterpret_cast<char*>(fields.data()), fields.size() * sizeof(FieldRecord));
+    in.read(reinterpret_cast<char*>(slots.data()), slots.size() * sizeof(Slot));
+    in.read(reinterpret_cast<char*>(bodies.data()), bodies.size() * sizeof(Body));
+    SlotMap bodySlots;
+    if (!in || !bodySlots.restore(std::move(slots), header.freeHead, bodies.size())) {
+        std::cerr << "Checkpoint " << filename << " is truncated or corrupt" << std::endl;
+        return false;
+    }
+
+    PhysicsConfig config;
+    config.gravityConstant = header.gravityConstant;
+    config.damping = header.damping;
+    config.maxVelocity = header.maxVelocity;
+    config.minDistance = header.minDistance;
+    config.boundaryRadius = header.boundaryRadius;
+    config.neighbourSkin = header.neighbourSkin;
+    config.periodicBoxSize = header.periodicBoxSize;
+    config.orbitalCorrection = (header.flags & orbitalCorrectionFlag) != 0;
+    config.continuousCollisions = (header.flags & continuousCollisionsFlag) != 0;
+    config.collisionMode = static_cast<CollisionMode>(header.collisionMode);
+    for (const auto& record : fields) {
+        config.externalFields.push_back(unpackField(record));
+    }
+
+    engine.setConfig(config);
+    engine.setForceLaw(std::move(forceLaw));
+    engine.setForceSolver(static_cast<PhysicsEngine::ForceSolver>(header.forceSolver));
+    engine.setTreeParameters(header.openingAngle, static_cast<std::size_t>(header.groupSize));
+    engine.setDualTreeOpeningAngle(header.dualOpeningAngle > 0.0f ? header.dualOpeningAngle
+                                                                  : Octree::defaultDualOpeningAngle);
+    engine.bodies = std::move(bodies);
+    engine.bodySlots = std::move(bodySlots);
+    engine.stepCount = header.stepCount;
+    engine.time = header.time;
+    engine.random.state = header.randomState;
+    ++engine.epoch;
+    // Scratch state is rebuilt on the next step: cost estimates, neighbour lists
+    engine.gravityCosts.clear();
+    engine.collisionCosts.clear();
+    engine.collisionPending.assign(engine.bodies.size(), 0);
+    engine.neighbourAnchors.clear();
+    return true;
+}
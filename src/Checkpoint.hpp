@@ -0,0 +1,29 @@
+#pragma once
+#include "PhysicsEngine.hpp"
+#include <cstdint>
+#include <string>
+
+// Versioned binary snapshot of a PhysicsEngine, for saving a run and
+// resuming it later. It holds every body, the handle table (so handles
+// taken before saving still resolve after loading), the step counter and
+// clock, the random generator, the solver, the force law and the physics
+// settings. A restored engine continues exactly as the saved one would have.
+//
+// Bodies and handles are stored as raw arrays in native byte order, so a
+// checkpoint is a few large sequential transfers either way. The file is
+// written beside its destination and renamed into place, so an interrupted
+// save never clobbers the previous checkpoint.
+//
+// Only physics that can be described as data is saved: the ForceLaws::
+// laws and the fields in config.externalFields. save() refuses an engine
+// running a custom force law or a field installed with setExternalField(),
+// since loading it would quietly switch to different physics.
+class Checkpoint {
+public:
+    // 2: the force law follows the header
+    static constexpr std::uint32_t version = 2;
+
+    static bool save(const std::string& filename, const PhysicsEngine& engine);
+    // Replaces the engine's state; on failure the engine is left untouched
+    static bool load(const std::string& filename, PhysicsEngine& engine);
+};
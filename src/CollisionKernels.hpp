@@ -0,0 +1,60 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Packed (structure-of-arrays) candidate pairs for the swept-sphere test:
+// relative position at the start of the step, relative displacement over
+// the step and the contact distance (sum of radii).
+struct SweptPairList {
+    std::vector<std::uint32_t> first, second;
+    std::vector<float> dx, dy, dz;
+    std::vector<float> wx, wy, wz;
+    std::vector<float> reach;
+    std::vector<float> toi;
+
+    void clear() {
+        first.clear(); second.clear();
+        dx.clear(); dy.clear(); dz.clear();
+        wx.clear(); wy.clear(); wz.clear();
+        reach.clear(); toi.clear();
+    }
+    void push(std::uint32_t i, std::uint32_t j, float px, float py, float pz,
+              float mx, float my, float mz, float r) {
+        first.push_back(i); second.push_back(j);
+        dx.push_back(px); dy.push_back(py); dz.push_back(pz);
+        wx.push_back(mx); wy.push_back(my); wz.push_back(mz);
+        reach.push_back(r);
+    }
+    std::size_t size() const { return first.size(); }
+};
+
+// Time of impact of two spheres moving linearly over one step, as a
+// fraction of the step: the smallest s in [0, 1] with |d + w s| = reach.
+// Pairs that already overlap report 0 and pairs that never touch report
+// a value above 1. The loop body has no branches, so the compiler can
+// evaluate several pairs per instruction.
+inline void sweptSphereTimes(SweptPairList& pairs) {
+    const std::size_t count = pairs.size();
+    pairs.toi.resize(count);
+    const float* dx = pairs.dx.data();
+    const float* dy = pairs.dy.data();
+    const float* dz = pairs.dz.data();
+    const float* wx = pairs.wx.data();
+    const float* wy = pairs.wy.data();
+    const float* wz = pairs.wz.data();
+    const float* reach = pairs.reach.data();
+    float* toi = pairs.toi.data();
+    for (std::size_t k = 0; k < count; ++k) {
+        // a s^2 + 2 b s + c = 0
+        float a = wx[k] * wx[k] + wy[k] * wy[k] + wz[k] * wz[k];
+        float b = dx[k] * wx[k] + dy[k] * wy[k] + dz[k] * wz[k];
+        float c = dx[k] * dx[k] + dy[k] * dy[k] + dz[k] * dz[k] - reach[k] * reach[k];
+        float disc = b * b - a * c;
+        float root = (-b - std::sqrt(std::max(disc, 0.0f))) / std::max(a, 1e-30f);
+        bool approaching = b < 0.0f && disc >= 0.0f && root <= 1.0f;
+        toi[k] = c <= 0.0f ? 0.0f : (approaching ? root : 2.0f);
+    }
+}
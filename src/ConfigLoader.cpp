@@ -1,14 +1,121 @@
 #include "ConfigLoader.hpp"
+#include "Json.hpp"
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <algorithm>
 
+namespace {
+    glm::vec3 readVec3(const JsonValue& json, const std::string& key, const glm::vec3& fallback) {
+        const JsonValue* v = json.find(key);
+        if (!v || !v->isArray() || v->array.size() != 3) return fallback;
+        glm::vec3 result = fallback;
+        for (int k = 0; k < 3; ++k) {
+            if (v->array[k].isNumber()) result[k] = static_cast<float>(v->array[k].number);
+        }
+        return result;
+    }
+}
+
 SimulationConfig ConfigLoader::loadConfig(const std::string& filename) {
+    std::ifstream file(filename);
+    if (!file) {
+        std::cerr << "Failed to open config file: " << filename << ", using built-in scene" << std::endl;
+        return defaultConfig();
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+
+    JsonValue root;
+    std::string error;
+    if (!JsonValue::parse(buffer.str(), root, error) || !root.isObject()) {
+        std::cerr << "Failed to parse config file " << filename << ": "
+                  << (error.empty() ? "expected a JSON object" : error) << ", using built-in scene" << std::endl;
+        return defaultConfig();
+    }
+
+    SimulationConfig config;
+    JsonValue empty;
+    empty.type = JsonValue::Type::Object;
+    const JsonValue* physics = root.find("physics");
+    const JsonValue* visual = root.find("visual");
+    config.physics = parsePhysics(physics ? *physics : empty);
+    config.visual = parseVisual(visual ? *visual : empty);
+    if (const JsonValue* objects = root.find("objects"); objects && objects->isArray()) {
+        for (const auto& object : objects->array) {
+            config.objects.push_back(parseObject(object));
+        }
+    }
+
+    std::cout << "Loaded configuration with " << config.objects.size() << " objects" << std::endl;
+    return config;
+}
+
+ObjectConfig ConfigLoader::parseObject(const JsonValue& json) {
+    ObjectConfig object;
+    object.name = json.getString("name", "Object");
+    object.type = json.getString("type", "orbiting");
+    object.position = readVec3(json, "position", glm::vec3(0.0f));
+    object.velocity = readVec3(json, "velocity", glm::vec3(0.0f));
+    object.mass = json.getFloat("mass", 1.0f);
+    object.radius = json.getFloat("radius", 0.1f);
+    object.color = readVec3(json, "color", glm::vec3(0.8f));
+    object.description = json.getString("description", "");
+    return object;
+}
+
+PhysicsConfig ConfigLoader::parsePhysics(const JsonValue& json) {
+    PhysicsConfig physics;
+    physics.gravityConstant = json.getFloat("gravityConstant", physics.gravityConstant);
+    physics.damping = json.getFloat("damping", physics.damping);
+    physics.maxVelocity = json.getFloat("maxVelocity", physics.maxVelocity);
+    physics.minDistance = json.getFloat("minDistance", physics.minDistance);
+    physics.boundaryRadius = json.getFloat("boundaryRadius", physics.boundaryRadius);
+    physics.orbitalCorrection = json.getBool("orbitalCorrection", physics.orbitalCorrection);
+    physics.continuousCollisions = json.getBool("continuousCollisions", physics.continuousCollisions);
+    physics.neighbourSkin = json.getFloat("neighbourSkin", physics.neighbourSkin);
+    physics.periodicBoxSize = json.getFloat("periodicBoxSize", physics.periodicBoxSize);
+    std::string collisionMode = json.getString("collisionMode", "separate");
+    if (collisionMode == "merge") {
+        physics.collisionMode = CollisionMode::Merge;
+    } else if (collisionMode != "separate") {
+        std::cerr << "Unknown collisionMode: " << collisionMode << ", using separate" << std::endl;
+    }
+    if (const JsonValue* fields = json.find("externalFields"); fields && fields->isArray()) {
+        for (const auto& field : fields->array) {
+            ExternalFieldConfig parsed = parseExternalField(field);
+            if (parsed.type == "uniform" || parsed.type == "harmonic" || parsed.type == "nfw") {
+                physics.externalFields.push_back(parsed);
+            } else {
+                std::cerr << "Ignoring external field of unknown type: " << parsed.type << std::endl;
+            }
+        }
+    }
+    return physics;
+}
+
+VisualConfig ConfigLoader::parseVisual(const JsonValue& json) {
+    VisualConfig visual;
+    visual.netGridSize = json.getFloat("netGridSize", 15.0f);
+    visual.deformationStrength = json.getFloat("deformationStrength", 0.8f);
+    visual.shadowSize = json.getFloat("shadowSize", 30.0f);
+    visual.shadowOpacity = json.getFloat("shadowOpacity", 0.6f);
+    return visual;
+}
+
+ExternalFieldConfig ConfigLoader::parseExternalField(const JsonValue& json) {
+    ExternalFieldConfig field;
+    field.type = json.getString("type", "");
+    field.center = readVec3(json, "center", field.center);
+    field.acceleration = readVec3(json, "acceleration", field.acceleration);
+    field.mass = json.getFloat("mass", field.mass);
+    field.scaleRadius = json.getFloat("scaleRadius", field.scaleRadius);
+    field.stiffness = json.getFloat("stiffness", field.stiffness);
+    return field;
+}
+
+SimulationConfig ConfigLoader::defaultConfig() {
     SimulationConfig config;
-    
-    // For now, we'll use hardcoded values that match the JSON
-    // In a full implementation, you'd use a proper JSON library like nlohmann/json
     
     // Physics configuration
     config.physics.gravityConstant = 0.02f;
@@ -16,6 +123,7 @@ SimulationConfig ConfigLoader::loadConfig(const std::string& filename) {
     config.physics.maxVelocity = 1.2f;
     config.physics.minDistance = 1.2f;
     config.physics.boundaryRadius = 12.0f;
+    config.physics.orbitalCorrection = true;
     
     // Visual configuration
     config.visual.netGridSize = 15.0f;
@@ -79,11 +187,10 @@ SimulationConfig ConfigLoader::loadConfig(const std::string& filename) {
     asteroid1.description = "Small asteroid (gray)";
     config.objects.push_back(asteroid1);
     
-    std::cout << "Loaded configuration with " << config.objects.size() << " objects" << std::endl;
     return config;
 }
 
-void ConfigLoader::saveConfig(const std::string& filename, const SimulationConfig& config) {
+void ConfigLoader::saveConfig(const std::string& /*filename*/, const SimulationConfig& /*config*/) {
     // Implementation for saving config would go here
     std::cout << "Config save not implemented yet" << std::endl;
 } 
\ No newline at end of file
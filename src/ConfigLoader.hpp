@@ -3,6 +3,8 @@
 #include <vector>
 #include <glm/glm.hpp>
 
+class JsonValue;
+
 struct ObjectConfig {
     std::string name;
     std::string type;
@@ -14,12 +16,46 @@ struct ObjectConfig {
     std::string description;
 };
 
+// Analytic background potential acting on every body. type is "uniform"
+// (constant acceleration), "harmonic" (pull of stiffness * offset toward
+// center) or "nfw" (NFW halo of characteristic mass and scaleRadius)
+struct ExternalFieldConfig {
+    std::string type;
+    glm::vec3 center = glm::vec3(0.0f);
+    glm::vec3 acceleration = glm::vec3(0.0f);
+    float mass = 0.0f;
+    float scaleRadius = 1.0f;
+    float stiffness = 0.0f;
+};
+
+// What happens to bodies closer than minDistance
+enum class CollisionMode {
+    Separate,   // push the pair apart and bounce
+    Merge       // perfect merge conserving mass and momentum
+};
+
+// A damping of 1 or a non-positive maxVelocity, minDistance, boundaryRadius
+// or periodicBoxSize switches that feature off in the physics engine
 struct PhysicsConfig {
-    float gravityConstant;
-    float damping;
-    float maxVelocity;
-    float minDistance;
-    float boundaryRadius;
+    float gravityConstant = 0.02f;
+    float damping = 0.999f;
+    float maxVelocity = 1.2f;
+    float minDistance = 1.2f;
+    float boundaryRadius = 12.0f;
+    bool orbitalCorrection = true; // steer orbiting bodies toward circular orbits
+    CollisionMode collisionMode = CollisionMode::Separate;
+    // Swept-sphere time-of-impact detection at the bodies' radii instead of
+    // the end-of-step minDistance test, so fast bodies cannot tunnel
+    bool continuousCollisions = false;
+    // Margin added to minDistance when building the collision neighbour lists;
+    // they are rebuilt once some body has moved more than half of it.
+    // Zero tests every pair every step.
+    float neighbourSkin = 0.3f;
+    // Side of a periodic box centred on the origin. Positive values replace
+    // the spherical wall: bodies wrap around, near interactions use the
+    // nearest image and gravity is Ewald summed over all images.
+    float periodicBoxSize = 0.0f;
+    std::vector<ExternalFieldConfig> externalFields;
 };
 
 struct VisualConfig {
@@ -35,13 +71,28 @@ struct SimulationConfig {
     VisualConfig visual;
 };
 
+// Objects an editor changed since the config was last applied, so that only
+// those have to be compared with the running simulation
+struct ConfigEdits {
+    std::vector<size_t> objects;    // indices of edited objects
+    bool allObjects = false;        // the list was replaced, e.g. by a preset
+    
+    void clear() {
+        objects.clear();
+        allObjects = false;
+    }
+};
+
 class ConfigLoader {
 public:
     static SimulationConfig loadConfig(const std::string& filename);
     static void saveConfig(const std::string& filename, const SimulationConfig& config);
     
 private:
-    static ObjectConfig parseObject(const std::string& jsonStr);
-    static PhysicsConfig parsePhysics(const std::string& jsonStr);
-    static VisualConfig parseVisual(const std::string& jsonStr);
+    // Built-in scene used when the file cannot be read
+    static SimulationConfig defaultConfig();
+    static ObjectConfig parseObject(const JsonValue& json);
+    static PhysicsConfig parsePhysics(const JsonValue& json);
+    static VisualConfig parseVisual(const JsonValue& json);
+    static ExternalFieldConfig parseExternalField(const JsonValue& json);
 }; 
\ No newline at end of file
@@ -0,0 +1,303 @@
+#include "Ensemble.hpp"
+#include "Ewald.hpp"
+#include "Json.hpp"
+#include "LaneBatch.hpp"
+#include "PhysicsEngine.hpp"
+#include "SceneSync.hpp"
+#include "TaskScheduler.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+namespace {
+    bool readPair(const JsonValue& json, float& first, float& second) {
+        if (!json.isArray() || json.array.size() != 2 || !json.array[0].isNumber() || !json.array[1].isNumber()) {
+            return false;
+        }
+        first = static_cast<float>(json.array[0].number);
+        second = static_cast<float>(json.array[1].number);
+        return true;
+    }
+
+    // "values": [...], "range": [low, high] with "count", or "uniform": [low, high]
+    bool parseParameter(const JsonValue& json, EnsembleParameter& parameter) {
+        parameter.name = json.getString("name", "");
+        if (parameter.name.empty()) {
+            std::cerr << "Ensemble parameter without a name" << std::endl;
+            return false;
+        }
+        if (const JsonValue* values = json.find("values"); values && values->isArray()) {
+            for (const auto& value : values->array) {
+                if (value.isNumber()) parameter.values.push_back(static_cast<float>(value.number));
+            }
+        } else if (const JsonValue* range = json.find("range")) {
+            float low, high;
+            const int count = static_cast<int>(json.getFloat("count", 0.0f));
+            if (!readPair(*range, low, high) || count < 1) {
+                std::cerr << "Ensemble parameter " << parameter.name << ": range needs [low, high] and a count" << std::endl;
+                return false;
+            }
+            for (int k = 0; k < count; ++k) {
+                parameter.values.push_back(count == 1 ? low : low + (high - low) * k / (count - 1));
+            }
+        } else if (const JsonValue* uniform = json.find("uniform")) {
+            if (!readPair(*uniform, parameter.low, parameter.high)) {
+                std::cerr << "Ensemble parameter " << parameter.name << ": uniform needs [low, high]" << std::endl;
+                return false;
+            }
+            parameter.uniform = true;
+            return true;
+        }
+        if (parameter.values.empty()) {
+            std::cerr << "Ensemble parameter " << parameter.name << " has no values" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    float* component(glm::vec3& v, const std::string& axis) {
+        if (axis == "x") return &v.x;
+        if (axis == "y") return &v.y;
+        if (axis == "z") return &v.z;
+        return nullptr;
+    }
+
+    void summarize(const std::vector<PhysicsEngine::Body>& bodies, EnsembleResult& result) {
+        result.bodies = bodies.size();
+        float totalMass = 0.0f;
+        glm::vec3 weighted(0.0f);
+        for (const auto& body : bodies) {
+            result.kineticEnergy += 0.5f * body.mass * glm::dot(body.velocity, body.velocity);
+            weighted += body.mass * body.position;
+            totalMass += body.mass;
+        }
+        if (totalMass > 0.0f) result.centerOfMass = weighted / totalMass;
+        for (const auto& body : bodies) {
+            result.maxRadius = std::max(result.maxRadius, glm::length(body.position - result.centerOfMass));
+        }
+    }
+}
+
+bool Ensemble::loadSpec(const std::string& filename, EnsembleSpec& spec) {
+    std::ifstream file(filename);
+    if (!file) {
+        std::cerr << "Failed to open ensemble file: " << filename << std::endl;
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+
+    JsonValue root;
+    std::string error;
+    if (!JsonValue::parse(buffer.str(), root, error) || !root.isObject()) {
+        std::cerr << "Failed to parse ensemble file " << filename << ": "
+                  << (error.empty() ? "expected a JSON object" : error) << std::endl;
+        return false;
+    }
+
+    spec = EnsembleSpec();
+    spec.baseConfig = root.getString("config", "simulation.json");
+    if (!spec.baseConfig.empty() && spec.baseConfig.front() != '/') {
+        const size_t slash = filename.find_last_of('/');
+        if (slash != std::string::npos) spec.baseConfig = filename.substr(0, slash + 1) + spec.baseConfig;
+    }
+    spec.members = static_cast<size_t>(root.getFloat("members", 0.0f));
+    spec.dt = root.getFloat("dt", spec.dt);
+    if (const JsonValue* seed = root.find("seed"); seed && seed->isNumber()) {
+        spec.seed = static_cast<std::uint32_t>(seed->number);
+    }
+    if (const JsonValue* steps = root.find("steps"); steps && steps->isNumber()) {
+        spec.steps = static_cast<std::uint64_t>(steps->number);
+    } else if (const JsonValue* time = root.find("time"); time && time->isNumber() && spec.dt > 0.0f) {
+        spec.steps = static_cast<std::uint64_t>(std::ceil(time->number / spec.dt));
+    }
+    if (const JsonValue* lanes = root.find("lanes"); lanes && lanes->type == JsonValue::Type::Bool) {
+        spec.lanes = lanes->boolean;
+    }
+    if (spec.dt <= 0.0f || spec.steps == 0) {
+        std::cerr << "Ensemble file " << filename << " needs a positive dt and steps or time" << std::endl;
+        return false;
+    }
+
+    if (const JsonValue* parameters = root.find("parameters"); parameters && parameters->isArray()) {
+        for (const auto& json : parameters->array) {
+            EnsembleParameter parameter;
+            if (!parseParameter(json, parameter)) return false;
+            spec.parameters.push_back(parameter);
+        }
+    }
+    return true;
+}
+
+size_t Ensemble::memberCount(const EnsembleSpec& spec) {
+    if (spec.members > 0) return spec.members;
+    size_t points = 1;
+    for (const auto& parameter : spec.parameters) {
+        if (!parameter.uniform) points *= parameter.values.size();
+    }
+    return points;
+}
+
+float* Ensemble::resolve(SimulationConfig& config, const std::string& name) {
+    PhysicsConfig& physics = config.physics;
+    if (name == "physics.gravityConstant") return &physics.gravityConstant;
+    if (name == "physics.damping") return &physics.damping;
+    if (name == "physics.maxVelocity") return &physics.maxVelocity;
+    if (name == "physics.minDistance") return &physics.minDistance;
+    if (name == "physics.boundaryRadius") return &physics.boundaryRadius;
+    if (name == "physics.neighbourSkin") return &physics.neighbourSkin;
+    if (name == "physics.periodicBoxSize") return &physics.periodicBoxSize;
+
+    const std::string prefix = "objects.";
+    if (name.compare(0, prefix.size(), prefix) != 0) return nullptr;
+    char* end = nullptr;
+    const unsigned long index = std::strtoul(name.c_str() + prefix.size(), &end, 10);
+    if (end == name.c_str() + prefix.size() || *end != '.' || index >= config.objects.size()) return nullptr;
+    ObjectConfig& object = config.objects[index];
+    const std::string field = end + 1;
+    if (field == "mass") return &object.mass;
+    if (field == "radius") return &object.radius;
+    if (field.compare(0, 9, "position.") == 0) return component(object.position, field.substr(9));
+    if (field.compare(0, 9, "velocity.") == 0) return component(object.velocity, field.substr(9));
+    return nullptr;
+}
+
+bool Ensemble::memberConfig(const EnsembleSpec& spec, const SimulationConfig& base, size_t member,
+                            SimulationConfig& out, std::vector<float>& values) {
+    out = base;
+    values.clear();
+    // Mixed-radix digits of the member index pick the grid point
+    size_t digits = member;
+    std::mt19937 random(0);
+    bool seeded = false;
+    for (const auto& parameter : spec.parameters) {
+        float value;
+        if (parameter.uniform) {
+            if (!seeded) {
+                std::seed_seq seq{spec.seed, static_cast<std::uint32_t>(member), static_cast<std::uint32_t>(static_cast<std::uint64_t>(member) >> 32)};
+                random.seed(seq);
+                seeded = true;
+            }
+            value = std::uniform_real_distribution<float>(parameter.low, parameter.high)(random);
+        } else {
+            value = parameter.values[digits % parameter.values.size()];
+            digits /= parameter.values.size();
+        }
+        float* target = resolve(out, parameter.name);
+        if (!target) {
+            std::cerr << "Unknown ensemble parameter: " << parameter.name << std::endl;
+            return false;
+        }
+        *target = value;
+        values.push_back(value);
+    }
+    return true;
+}
+
+bool Ensemble::run(const EnsembleSpec& spec, const SimulationConfig& base, std::vector<EnsembleResult>& results) {
+    const size_t members = memberCount(spec);
+    std::vector<SimulationConfig> configs(members);
+    results.assign(members, EnsembleResult());
+    for (size_t member = 0; member < members; ++member) {
+        if (!memberConfig(spec, base, member, configs[member], results[member].values)) return false;
+    }
+
+    // Members are independent. Small scenes the lane kernel covers are
+    // grouped LaneBatch::width to a task; every other member is a task of
+    // its own, which still splits its passes if the scene is large.
+    const size_t bodyCount = base.objects.size();
+    auto batched = [&](size_t member) {
+        return spec.lanes && bodyCount <= LaneBatch::maxBodies && LaneBatch::supports(configs[member].physics);
+    };
+    // Members build their engines inside the tasks below, too late to build
+    // the Ewald table for a periodic box
+    for (const SimulationConfig& config : configs) {
+        if (config.physics.periodicBoxSize > 0.0f) {
+            EwaldTable::instance();
+            break;
+        }
+    }
+    std::vector<std::vector<size_t>> tasks;
+    std::vector<size_t> batch;
+    for (size_t member = 0; member < members; ++member) {
+        if (!batched(member)) {
+            tasks.push_back({member});
+            continue;
+        }
+        batch.push_back(member);
+        if (batch.size() == LaneBatch::width) {
+            tasks.push_back(batch);
+            batch.clear();
+        }
+    }
+    if (!batch.empty()) tasks.push_back(batch);
+
+    auto start = [&](size_t member, PhysicsEngine& engine) {
+        // Every member draws its own collision kicks, whatever runs it
+        engine.seedRandom(SplitMix64{(std::uint64_t(spec.seed) << 32) ^ member}.next());
+        SceneSync scene;
+        scene.apply(configs[member], engine);
+    };
+    auto runSteps = [&](auto& stepper) {
+        for (std::uint64_t done = 0; done < spec.steps;) {
+            const std::uint64_t count = std::min<std::uint64_t>(spec.steps - done, 1u << 30);
+            stepper.advance(spec.dt, static_cast<unsigned>(count));
+            done += count;
+        }
+    };
+    TaskScheduler::instance().parallelFor(tasks.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t task = begin; task < end; ++task) {
+            const std::vector<size_t>& group = tasks[task];
+            if (!batched(group.front())) {
+                PhysicsEngine engine(configs[group.front()].physics);
+                start(group.front(), engine);
+                runSteps(engine);
+                summarize(engine.getBodies(), results[group.front()]);
+                continue;
+            }
+            LaneBatch lanes(bodyCount);
+            for (size_t lane = 0; lane < group.size(); ++lane) {
+                PhysicsEngine engine(configs[group[lane]].physics);
+                start(group[lane], engine);
+                lanes.load(lane, engine);
+            }
+            runSteps(lanes);
+            std::vector<PhysicsEngine::Body> bodies;
+            for (size_t lane = 0; lane < group.size(); ++lane) {
+                lanes.store(lane, bodies);
+                summarize(bodies, results[group[lane]]);
+            }
+        }
+    });
+    return true;
+}
+
+bool Ensemble::writeSummary(const std::string& filename, const EnsembleSpec& spec,
+                            const std::vector<EnsembleResult>& results) {
+    std::ofstream out(filename);
+    if (!out) {
+        std::cerr << "Failed to open output file: " << filename << std::endl;
+        return false;
+    }
+    out.precision(9);
+    out << "member";
+    for (const auto& parameter : spec.parameters) out << ',' << parameter.name;
+    out << ",bodies,kineticEnergy,maxRadius,comX,comY,comZ\n";
+    for (size_t member = 0; member < results.size(); ++member) {
+        const EnsembleResult& result = results[member];
+        out << member;
+        for (float value : result.values) out << ',' << value;
+        out << ',' << result.bodies << ',' << result.kineticEnergy << ',' << result.maxRadius << ','
+            << result.centerOfMass.x << ',' << result.centerOfMass.y << ',' << result.centerOfMass.z << '\n';
+    }
+    out.flush();
+    if (!out) {
+        std::cerr << "Failed to write output file: " << filename << std::endl;
+        return false;
+    }
+    return true;
+}
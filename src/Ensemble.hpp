@@ -0,0 +1,64 @@
+#pragma once
+#include "ConfigLoader.hpp"
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// One swept quantity. name is "physics.<field>" (gravityConstant, damping,
+// maxVelocity, minDistance, boundaryRadius, neighbourSkin, periodicBoxSize)
+// or "objects.<index>.<field>" (mass, radius, position.x, velocity.z, ...).
+struct EnsembleParameter {
+    std::string name;
+    // Grid axes take every listed value; uniform parameters are drawn per
+    // member from [low, high]
+    bool uniform = false;
+    std::vector<float> values;
+    float low = 0.0f, high = 0.0f;
+};
+
+// Sweep over copies of a base scene. Members walk the Cartesian product of
+// the grid axes (the first axis varies fastest), wrapping around if there
+// are more members than grid points.
+struct EnsembleSpec {
+    std::string baseConfig;
+    std::size_t members = 0;        // 0: one member per grid point
+    std::uint64_t steps = 0;
+    float dt = 0.016f;
+    std::uint32_t seed = 1;         // uniform draws depend only on seed and member
+    // Step small scenes LaneBatch::width members at a time in SIMD lanes
+    bool lanes = true;
+    std::vector<EnsembleParameter> parameters;
+};
+
+// Final state of one member, reduced to a row of the summary table
+struct EnsembleResult {
+    std::vector<float> values;      // the member's parameter values
+    std::size_t bodies = 0;         // fewer than at the start once bodies merge
+    float kineticEnergy = 0.0f;
+    float maxRadius = 0.0f;         // farthest body from the centre of mass
+    glm::vec3 centerOfMass = glm::vec3(0.0f);
+};
+
+class Ensemble {
+public:
+    // Reads a sweep specification; relative baseConfig paths are taken from
+    // the specification's directory
+    static bool loadSpec(const std::string& filename, EnsembleSpec& spec);
+
+    static std::size_t memberCount(const EnsembleSpec& spec);
+    // base with the member's parameter values applied, which are also returned in values
+    static bool memberConfig(const EnsembleSpec& spec, const SimulationConfig& base, std::size_t member,
+                             SimulationConfig& out, std::vector<float>& values);
+
+    // Runs every member to completion, members spread over the task scheduler.
+    // Small scenes the lane kernel covers run in batches of LaneBatch::width.
+    static bool run(const EnsembleSpec& spec, const SimulationConfig& base, std::vector<EnsembleResult>& results);
+
+    static bool writeSummary(const std::string& filename, const EnsembleSpec& spec,
+                             const std::vector<EnsembleResult>& results);
+
+private:
+    static float* resolve(SimulationConfig& config, const std::string& name);
+};
@@ -0,0 +1,72 @@
+#include "Ewald.hpp"
+#include "TaskScheduler.hpp"
+
+namespace {
+    constexpr double pi = 3.14159265358979323846;
+    // Splitting scale for the unit box: both sums converge to float precision
+    // with images within 3 box lengths and wave vectors with |h|^2 <= 10
+    constexpr double alpha = 2.0;
+}
+
+const EwaldTable& EwaldTable::instance() {
+    static const EwaldTable table;
+    return table;
+}
+
+EwaldTable::EwaldTable() {
+    const std::size_t stride = resolution + 1;
+    samples.resize(stride * stride * stride);
+    TaskScheduler::instance().parallelFor(stride, 1, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            for (std::size_t j = 0; j < stride; ++j) {
+                for (std::size_t k = 0; k < stride; ++k) {
+                    glm::vec3 d = glm::vec3(float(i), float(j), float(k)) * (extent / resolution);
+                    glm::vec3 c = evaluate(d);
+                    samples[(i * stride + j) * stride + k] = {{c.x, c.y, c.z, 0.0f}};
+                }
+            }
+        }
+    });
+}
+
+glm::vec3 EwaldTable::evaluate(const glm::vec3& d) {
+    double r2 = double(d.x) * d.x + double(d.y) * d.y + double(d.z) * d.z;
+    if (r2 == 0.0) return glm::vec3(0.0f);
+
+    // Start from minus the nearest image, which the caller adds itself
+    double r = std::sqrt(r2);
+    double cx = -d.x / (r2 * r), cy = -d.y / (r2 * r), cz = -d.z / (r2 * r);
+
+    // Real space: screened images
+    for (int nx = -3; nx <= 3; ++nx) {
+        for (int ny = -3; ny <= 3; ++ny) {
+            for (int nz = -3; nz <= 3; ++nz) {
+                double x = d.x + nx, y = d.y + ny, z = d.z + nz;
+                double s2 = x * x + y * y + z * z;
+                if (s2 > 9.0 || s2 == 0.0) continue;
+                double s = std::sqrt(s2);
+                double f = (std::erfc(alpha * s) + 2.0 * alpha * s / std::sqrt(pi) * std::exp(-alpha * alpha * s2))
+                           / (s2 * s);
+                cx += x * f;
+                cy += y * f;
+                cz += z * f;
+            }
+        }
+    }
+
+    // Reciprocal space
+    for (int hx = -3; hx <= 3; ++hx) {
+        for (int hy = -3; hy <= 3; ++hy) {
+            for (int hz = -3; hz <= 3; ++hz) {
+                int h2 = hx * hx + hy * hy + hz * hz;
+                if (h2 == 0 || h2 > 10) continue;
+                double phase = 2.0 * pi * (hx * d.x + hy * d.y + hz * d.z);
+                double f = 2.0 / h2 * std::exp(-pi * pi * h2 / (alpha * alpha)) * std::sin(phase);
+                cx += hx * f;
+                cy += hy * f;
+                cz += hz * f;
+            }
+        }
+    }
+    return glm::vec3(static_cast<float>(cx), static_cast<float>(cy), static_cast<float>(cz));
+}
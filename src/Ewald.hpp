@@ -0,0 +1,141 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <cmath>
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+// Periodic boundaries: positions live in the cube [-L/2, L/2)^3 and every
+// separation is taken to the nearest image of the other body.
+namespace Periodic {
+    inline float wrap(float x, float boxSize) {
+        return x - boxSize * std::floor(x / boxSize + 0.5f);
+    }
+
+    // Nearest image of a separation of less than 1.5 box lengths, such as
+    // between two points in the box; cheaper than wrap() in inner loops
+    inline float nearest(float d, float boxSize) {
+        const float half = 0.5f * boxSize;
+        d = d >= half ? d - boxSize : d;
+        return d < -half ? d + boxSize : d;
+    }
+
+    inline glm::vec3 wrap(const glm::vec3& p, float boxSize) {
+        return glm::vec3(wrap(p.x, boxSize), wrap(p.y, boxSize), wrap(p.z, boxSize));
+    }
+
+    // Same as wrap(); separations and positions share the range [-L/2, L/2)
+    inline glm::vec3 minimumImage(const glm::vec3& d, float boxSize) {
+        return wrap(d, boxSize);
+    }
+}
+
+// Ewald correction for periodic gravity. For a separation d (source -
+// target) the acceleration from a unit mass and all of its periodic images,
+// with a uniform neutralising background, is d / |d|^3 + correction(d).
+// The correction is smooth as long as d stays near the central cell, so it
+// is tabulated once for the unit box (real plus reciprocal space sums) up
+// to |d| = 3L/4 per axis and trilinearly interpolated. Only one octant is
+// stored since it is odd in each axis.
+// The correction does not depend on the force law: it assumes the law is
+// Newtonian at long range.
+class EwaldTable {
+public:
+    static constexpr int resolution = 48;   // cells per axis over [0, extent * L]
+    static constexpr float extent = 0.75f;
+
+    // Built on first use; the table for any box size is a rescaling. The
+    // build is a parallelFor, so the first call must not come from inside a
+    // scheduler task: a thread waiting on it may pick up another task that
+    // calls instance() again and block on its own initialisation.
+    static const EwaldTable& instance();
+
+    glm::vec3 correction(float dx, float dy, float dz, float boxSize) const {
+        const float scale = resolution / (extent * boxSize);
+        float u = std::min(std::fabs(dx) * scale, float(resolution) - 1e-3f);
+        float v = std::min(std::fabs(dy) * scale, float(resolution) - 1e-3f);
+        float w = std::min(std::fabs(dz) * scale, float(resolution) - 1e-3f);
+        int i = static_cast<int>(u), j = static_cast<int>(v), k = static_cast<int>(w);
+        float fu = u - i, fv = v - j, fw = w - k;
+
+        // Interpolate along z within each of the four x/y corner columns,
+        // whose two samples sit next to each other
+        const std::size_t stride = resolution + 1;
+        const Sample* s00 = &samples[(static_cast<std::size_t>(i) * stride + j) * stride + k];
+        const Sample* s01 = s00 + stride;
+        const Sample* s10 = s00 + stride * stride;
+        const Sample* s11 = s10 + stride;
+        float c[3];
+        for (int n = 0; n < 3; ++n) {
+            float c00 = s00[0].f[n] + fw * (s00[1].f[n] - s00[0].f[n]);
+            float c01 = s01[0].f[n] + fw * (s01[1].f[n] - s01[0].f[n]);
+            float c10 = s10[0].f[n] + fw * (s10[1].f[n] - s10[0].f[n]);
+            float c11 = s11[0].f[n] + fw * (s11[1].f[n] - s11[0].f[n]);
+            float c0 = c00 + fv * (c01 - c00);
+            float c1 = c10 + fv * (c11 - c10);
+            c[n] = c0 + fu * (c1 - c0);
+        }
+        const float invL2 = 1.0f / (boxSize * boxSize);
+        return glm::vec3(dx < 0.0f ? -c[0] : c[0], dy < 0.0f ? -c[1] : c[1], dz < 0.0f ? -c[2] : c[2]) * invL2;
+    }
+
+    // Sum of the corrections from every source felt at target. Sources are
+    // taken as given, so each must be within 3L/4 of target on every axis.
+    glm::vec3 accumulate(const float* sx, const float* sy, const float* sz, const float* sm,
+                         std::size_t sourceCount, const glm::vec3& target, float boxSize) const {
+        glm::vec3 sum(0.0f);
+        for (std::size_t k = 0; k < sourceCount; ++k) {
+            sum += correction(sx[k] - target.x, sy[k] - target.y, sz[k] - target.z, boxSize) * sm[k];
+        }
+        return sum;
+    }
+
+    // Same, with every source taken to its image nearest target
+    glm::vec3 accumulateNearest(const float* sx, const float* sy, const float* sz, const float* sm,
+                                std::size_t sourceCount, const glm::vec3& target, float boxSize) const {
+        glm::vec3 sum(0.0f);
+        for (std::size_t k = 0; k < sourceCount; ++k) {
+            sum += correction(Periodic::nearest(sx[k] - target.x, boxSize),
+                              Periodic::nearest(sy[k] - target.y, boxSize),
+                              Periodic::nearest(sz[k] - target.z, boxSize), boxSize) * sm[k];
+        }
+        return sum;
+    }
+
+    // Exact correction in the unit box, by direct Ewald summation
+    static glm::vec3 evaluate(const glm::vec3& d);
+
+private:
+    EwaldTable();
+
+    struct Sample {
+        float f[4];     // correction x, y, z and padding, for aligned loads
+    };
+    std::vector<Sample> samples;   // (resolution + 1)^3 samples, x-major
+};
+
+// Periodic counterpart of accumulateGravity(): the nearest image of every
+// source through law. Sources and targets must lie in the box. The other
+// images are added by EwaldTable::accumulateNearest().
+template <class Law>
+inline void accumulateNearestImage(const Law& law, float boxSize,
+                                   const float* __restrict sx, const float* __restrict sy,
+                                   const float* __restrict sz, const float* __restrict sm,
+                                   std::size_t sourceCount,
+                                   const float* __restrict tx, const float* __restrict ty,
+                                   const float* __restrict tz,
+                                   float* __restrict ax, float* __restrict ay, float* __restrict az,
+                                   std::size_t targetCount) {
+    for (std::size_t k = 0; k < sourceCount; ++k) {
+        const float px = sx[k], py = sy[k], pz = sz[k], pm = sm[k];
+        for (std::size_t i = 0; i < targetCount; ++i) {
+            float dx = Periodic::nearest(px - tx[i], boxSize);
+            float dy = Periodic::nearest(py - ty[i], boxSize);
+            float dz = Periodic::nearest(pz - tz[i], boxSize);
+            float s = pm * law(dx * dx + dy * dy + dz * dz);
+            ax[i] += dx * s;
+            ay[i] += dy * s;
+            az[i] += dz * s;
+        }
+    }
+}
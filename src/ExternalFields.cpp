@@ -0,0 +1,56 @@
+#include "ExternalFields.hpp"
+#include "ConfigLoader.hpp"
+
+namespace {
+    template <class... Fields>
+    ExternalField withHalos(const std::vector<ExternalFields::NFWHalo>& halos, Fields... fields) {
+        if (halos.empty()) {
+            if constexpr (sizeof...(Fields) == 0) {
+                return ExternalField();
+            } else {
+                return ExternalFields::combine(fields...);
+            }
+        }
+        if (halos.size() == 1) {
+            return ExternalFields::combine(fields..., halos[0]);
+        }
+        return ExternalFields::combine(fields..., ExternalFields::HaloList{halos});
+    }
+
+    template <class... Fields>
+    ExternalField withTrap(bool hasTrap, const ExternalFields::HarmonicTrap& trap,
+                           const std::vector<ExternalFields::NFWHalo>& halos, Fields... fields) {
+        return hasTrap ? withHalos(halos, fields..., trap) : withHalos(halos, fields...);
+    }
+}
+
+ExternalField ExternalField::fromConfig(const std::vector<ExternalFieldConfig>& configs) {
+    bool hasUniform = false;
+    bool hasTrap = false;
+    ExternalFields::Uniform uniform;
+    ExternalFields::HarmonicTrap trap;
+    glm::vec3 weightedCenter(0.0f);
+    std::vector<ExternalFields::NFWHalo> halos;
+
+    for (const auto& config : configs) {
+        if (config.type == "uniform") {
+            hasUniform = true;
+            uniform.acceleration += config.acceleration;
+        } else if (config.type == "harmonic") {
+            // Traps add up to one trap centred on their stiffness-weighted centre
+            hasTrap = true;
+            trap.stiffness += config.stiffness;
+            weightedCenter += config.center * config.stiffness;
+        } else if (config.type == "nfw" && config.scaleRadius > 0.0f) {
+            halos.push_back({config.center, config.mass, config.scaleRadius});
+        }
+    }
+    if (hasTrap && trap.stiffness != 0.0f) {
+        trap.center = weightedCenter / trap.stiffness;
+    }
+
+    if (hasUniform) {
+        return withTrap(hasTrap, trap, halos, uniform);
+    }
+    return withTrap(hasTrap, trap, halos);
+}
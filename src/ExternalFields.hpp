@@ -0,0 +1,130 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <cmath>
+#include <cstddef>
+#include <memory>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+struct ExternalFieldConfig;
+
+// Analytic background potentials. Each field is a small functor returning
+// the acceleration at a position; G is the simulation's gravity constant,
+// used by fields that are specified by a mass.
+namespace ExternalFields {
+    // Constant acceleration everywhere
+    struct Uniform {
+        glm::vec3 acceleration = glm::vec3(0.0f);
+
+        glm::vec3 operator()(const glm::vec3&, float) const {
+            return acceleration;
+        }
+    };
+
+    // Isotropic harmonic trap: a = -stiffness * (p - center)
+    struct HarmonicTrap {
+        glm::vec3 center = glm::vec3(0.0f);
+        float stiffness = 0.0f;
+
+        glm::vec3 operator()(const glm::vec3& p, float) const {
+            return (center - p) * stiffness;
+        }
+    };
+
+    // NFW dark matter halo. The enclosed mass is
+    // mass * (ln(1 + x) - x / (1 + x)) with x = r / scaleRadius.
+    struct NFWHalo {
+        glm::vec3 center = glm::vec3(0.0f);
+        float mass = 0.0f;
+        float scaleRadius = 1.0f;
+
+        glm::vec3 operator()(const glm::vec3& p, float G) const {
+            glm::vec3 d = center - p;
+            float r2 = glm::dot(d, d);
+            if (r2 <= 0.0f) return glm::vec3(0.0f);
+            float r = std::sqrt(r2);
+            float x = r / scaleRadius;
+            // The series avoids cancellation near the centre, where the
+            // enclosed mass goes as x^2 / 2
+            float enclosed = x < 1e-2f ? x * x * (0.5f - x * (2.0f / 3.0f))
+                                       : std::log1p(x) - x / (1.0f + x);
+            return d * (G * mass * enclosed / (r2 * r));
+        }
+    };
+
+    // Any number of halos, for configurations that are only known at run time
+    struct HaloList {
+        std::vector<NFWHalo> halos;
+
+        glm::vec3 operator()(const glm::vec3& p, float G) const {
+            glm::vec3 sum(0.0f);
+            for (const auto& halo : halos) {
+                sum += halo(p, G);
+            }
+            return sum;
+        }
+    };
+
+    // Sum of fields fixed at compile time, evaluated with no indirection
+    template <class... Fields>
+    struct Composite {
+        std::tuple<Fields...> fields;
+
+        glm::vec3 operator()(const glm::vec3& p, float G) const {
+            return std::apply([&](const Fields&... f) {
+                return (glm::vec3(0.0f) + ... + f(p, G));
+            }, fields);
+        }
+    };
+
+    template <class... Fields>
+    Composite<Fields...> combine(Fields... fields) {
+        return {std::tuple<Fields...>(std::move(fields)...)};
+    }
+}
+
+// Type-erased external field, bound to a per-block kernel compiled for the
+// concrete field type like ForceLaw. An empty field does nothing.
+class ExternalField {
+public:
+    ExternalField() = default;
+
+    template <class Field>
+    ExternalField(Field field)
+        : state(std::make_shared<Field>(std::move(field))),
+          kernel(&evaluate<Field>) {}
+
+    // Builds the field described by a configuration. Uniform fields and
+    // harmonic traps are summed into one of each, and the combination
+    // present is dispatched to a matching Composite instantiation.
+    static ExternalField fromConfig(const std::vector<ExternalFieldConfig>& configs);
+
+    explicit operator bool() const { return kernel != nullptr; }
+
+    // Adds the field to accel[0, count). Positions are read from a strided
+    // array, so they can be taken directly from an array of bodies.
+    void accumulate(const glm::vec3* positions, std::size_t strideBytes,
+                    glm::vec3* accel, std::size_t count, float gravityConstant) const {
+        if (kernel) {
+            kernel(state.get(), reinterpret_cast<const unsigned char*>(positions), strideBytes,
+                   accel, count, gravityConstant);
+        }
+    }
+
+private:
+    using Kernel = void (*)(const void*, const unsigned char*, std::size_t, glm::vec3*, std::size_t, float);
+
+    std::shared_ptr<const void> state;
+    Kernel kernel = nullptr;
+
+    template <class Field>
+    static void evaluate(const void* field, const unsigned char* positions, std::size_t strideBytes,
+                         glm::vec3* accel, std::size_t count, float gravityConstant) {
+        const Field& f = *static_cast<const Field*>(field);
+        for (std::size_t i = 0; i < count; ++i) {
+            const glm::vec3& p = *reinterpret_cast<const glm::vec3*>(positions + i * strideBytes);
+            accel[i] += f(p, gravityConstant);
+        }
+    }
+};
@@ -0,0 +1,196 @@
+#pragma once
+#include "Ewald.hpp"
+#include "GravityKernels.hpp"
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+// Pairwise force laws. Each is a small functor mapping the squared
+// separation r2 to the factor f such that a = G * m * f * d; for plain
+// Newtonian gravity f = 1/r^3. Any callable with the signature
+// float(float r2) can be used the same way, as long as it is finite at
+// r2 = 0 (self terms are multiplied by a zero separation).
+namespace ForceLaws {
+    // Plummer softening: Newtonian gravity with r^2 replaced by r^2 + eps^2
+    struct Plummer {
+        float softening2 = 1e-6f;
+
+        float operator()(float r2) const {
+            float invDist = 1.0f / std::sqrt(r2 + softening2);
+            return invDist * invDist * invDist;
+        }
+    };
+
+    // Cubic spline softening (Monaghan & Lattanzio kernel, GADGET-2 form):
+    // exactly Newtonian beyond softeningLength, smoothly finite inside it
+    struct Spline {
+        float softeningLength = 0.01f;
+
+        float operator()(float r2) const {
+            const float h = softeningLength;
+            const float r = std::sqrt(r2);
+            const float u = r / h;
+            const float invH3 = 1.0f / (h * h * h);
+            if (u < 0.5f) {
+                return invH3 * (10.666666667f + u * u * (32.0f * u - 38.4f));
+            } else if (u < 1.0f) {
+                return invH3 * (21.333333333f - 48.0f * u + 38.4f * u * u - 10.666666667f * u * u * u
+                                - 0.066666667f / (u * u * u));
+            }
+            return 1.0f / (r2 * r);
+        }
+    };
+
+    // Yukawa (screened) gravity: potential -G m exp(-r / lambda) / r.
+    // expf has no vector form without -ffast-math, so its kernels stay scalar.
+    struct Yukawa {
+        float screeningLength = 5.0f;
+        float softening2 = 1e-6f;
+
+        float operator()(float r2) const {
+            float soft2 = r2 + softening2;
+            float r = std::sqrt(soft2);
+            float x = r / screeningLength;
+            return std::exp(-x) * (1.0f + x) / (soft2 * r);
+        }
+    };
+}
+
+// Type-erased force law. The concrete law is bound once to kernel
+// instantiations compiled for its type, so alternative physics costs one
+// indirect call per kernel invocation and never one per interaction.
+class ForceLaw {
+public:
+    // The ForceLaws:: functors are tagged with their parameters, so a law
+    // built from one can be recognised and saved; any other callable is Custom
+    enum class Kind : std::uint32_t { Custom, Plummer, Spline, Yukawa };
+    static constexpr std::size_t maxParameters = 2;
+
+    ForceLaw() : ForceLaw(ForceLaws::Plummer{}) {}
+
+    template <class Law>
+    ForceLaw(Law law)
+        : state(std::make_shared<Law>(std::move(law))),
+          gatherKernel(&gather<Law>),
+          mutualKernel(&mutual<Law>),
+          periodicKernel(&periodic<Law>),
+          scalarKernel(&scalar<Law>) {
+        kind = describe(*static_cast<const Law*>(state.get()), parameters);
+    }
+
+    // Rebuilds a tagged law from its parameters; false for Custom or an unknown kind
+    static bool fromParameters(Kind kind, const float* parameters, ForceLaw& law) {
+        switch (kind) {
+            case Kind::Plummer: law = ForceLaws::Plummer{parameters[0]}; return true;
+            case Kind::Spline: law = ForceLaws::Spline{parameters[0]}; return true;
+            case Kind::Yukawa: law = ForceLaws::Yukawa{parameters[0], parameters[1]}; return true;
+            default: return false;
+        }
+    }
+
+    Kind getKind() const { return kind; }
+    // The tagged law's members in declaration order, unused ones zero
+    const float* getParameters() const { return parameters; }
+    // The law every engine starts with: Plummer at its default softening
+    bool isDefault() const { return kind == Kind::Plummer && parameters[0] == ForceLaws::Plummer{}.softening2; }
+
+    // accumulateGravity() with this law
+    void accumulate(const float* sx, const float* sy, const float* sz, const float* sm, std::size_t sourceCount,
+                    const float* tx, const float* ty, const float* tz,
+                    float* ax, float* ay, float* az, std::size_t targetCount) const {
+        gatherKernel(state.get(), sx, sy, sz, sm, sourceCount, tx, ty, tz, ax, ay, az, targetCount);
+    }
+
+    // accumulateMutual() with this law
+    void accumulatePairs(const float* x, const float* y, const float* z, const float* m,
+                         float* ax, float* ay, float* az,
+                         std::uint32_t aBegin, std::uint32_t aEnd, std::uint32_t bBegin, std::uint32_t bEnd) const {
+        mutualKernel(state.get(), x, y, z, m, ax, ay, az, aBegin, aEnd, bBegin, bEnd);
+    }
+
+    // accumulateNearestImage() with this law
+    void accumulatePeriodic(float boxSize,
+                            const float* sx, const float* sy, const float* sz, const float* sm, std::size_t sourceCount,
+                            const float* tx, const float* ty, const float* tz,
+                            float* ax, float* ay, float* az, std::size_t targetCount) const {
+        periodicKernel(state.get(), boxSize, sx, sy, sz, sm, sourceCount, tx, ty, tz, ax, ay, az, targetCount);
+    }
+
+    // Single evaluation, for per-node work outside the inner loops
+    float factor(float r2) const {
+        return scalarKernel(state.get(), r2);
+    }
+
+    // d factor / d r2, by central differences
+    float derivative(float r2) const {
+        float h = r2 * 1e-3f + 1e-12f;
+        return (factor(r2 + h) - factor(r2 - h)) / (2.0f * h);
+    }
+
+private:
+    using GatherKernel = void (*)(const void*, const float*, const float*, const float*, const float*, std::size_t,
+                                  const float*, const float*, const float*, float*, float*, float*, std::size_t);
+    using MutualKernel = void (*)(const void*, const float*, const float*, const float*, const float*,
+                                  float*, float*, float*, std::uint32_t, std::uint32_t, std::uint32_t, std::uint32_t);
+    using PeriodicKernel = void (*)(const void*, float,
+                                    const float*, const float*, const float*, const float*, std::size_t,
+                                    const float*, const float*, const float*, float*, float*, float*, std::size_t);
+    using ScalarKernel = float (*)(const void*, float);
+
+    std::shared_ptr<const void> state;
+    Kind kind = Kind::Custom;
+    float parameters[maxParameters] = {};
+    GatherKernel gatherKernel;
+    MutualKernel mutualKernel;
+    PeriodicKernel periodicKernel;
+    ScalarKernel scalarKernel;
+
+    static Kind describe(const ForceLaws::Plummer& law, float* p) {
+        p[0] = law.softening2;
+        return Kind::Plummer;
+    }
+    static Kind describe(const ForceLaws::Spline& law, float* p) {
+        p[0] = law.softeningLength;
+        return Kind::Spline;
+    }
+    static Kind describe(const ForceLaws::Yukawa& law, float* p) {
+        p[0] = law.screeningLength;
+        p[1] = law.softening2;
+        return Kind::Yukawa;
+    }
+    template <class Law>
+    static Kind describe(const Law&, float*) {
+        return Kind::Custom;
+    }
+
+    template <class Law>
+    static void gather(const void* law, const float* sx, const float* sy, const float* sz, const float* sm,
+                       std::size_t sourceCount, const float* tx, const float* ty, const float* tz,
+                       float* ax, float* ay, float* az, std::size_t targetCount) {
+        accumulateGravity(*static_cast<const Law*>(law), sx, sy, sz, sm, sourceCount,
+                          tx, ty, tz, ax, ay, az, targetCount);
+    }
+
+    template <class Law>
+    static void mutual(const void* law, const float* x, const float* y, const float* z, const float* m,
+                       float* ax, float* ay, float* az,
+                       std::uint32_t aBegin, std::uint32_t aEnd, std::uint32_t bBegin, std::uint32_t bEnd) {
+        accumulateMutual(*static_cast<const Law*>(law), x, y, z, m, ax, ay, az, aBegin, aEnd, bBegin, bEnd);
+    }
+
+    template <class Law>
+    static void periodic(const void* law, float boxSize,
+                         const float* sx, const float* sy, const float* sz, const float* sm, std::size_t sourceCount,
+                         const float* tx, const float* ty, const float* tz,
+                         float* ax, float* ay, float* az, std::size_t targetCount) {
+        accumulateNearestImage(*static_cast<const Law*>(law), boxSize, sx, sy, sz, sm, sourceCount,
+                               tx, ty, tz, ax, ay, az, targetCount);
+    }
+
+    template <class Law>
+    static float scalar(const void* law, float r2) {
+        return (*static_cast<const Law*>(law))(r2);
+    }
+};
@@ -0,0 +1,100 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Packed (structure-of-arrays) source list: positions and masses of the
+// point masses a group of bodies interacts with. Tree nodes are stored as
+// their monopole (centre of mass + total mass), so nodes and bodies share
+// one list and one kernel.
+struct InteractionList {
+    std::vector<float> x, y, z, m;
+
+    void clear() {
+        x.clear(); y.clear(); z.clear(); m.clear();
+    }
+    void push(float px, float py, float pz, float mass) {
+        x.push_back(px); y.push_back(py); z.push_back(pz); m.push_back(mass);
+    }
+    std::size_t size() const { return m.size(); }
+};
+
+// Dense gravity kernel: accumulates the pull of every source on every
+// target. law(r2) returns the factor f with acceleration = m * f * d for a
+// separation d of squared length r2 (1/r^3 for plain Newtonian gravity).
+// The source loop is outermost so the inner loop runs over contiguous
+// target arrays with no reduction, which lets the compiler emit SIMD code
+// without -ffast-math. That takes two more things: the arrays must not
+// overlap (hence __restrict, which spares the runtime alias checks the cost
+// model gives up on) and sqrt must not set errno (-fno-math-errno, set on
+// gravitysim_physics and its users). Accelerations are left unscaled by G.
+template <class Law>
+inline void accumulateGravity(const Law& law,
+                              const float* __restrict sx, const float* __restrict sy,
+                              const float* __restrict sz, const float* __restrict sm,
+                              std::size_t sourceCount,
+                              const float* __restrict tx, const float* __restrict ty, const float* __restrict tz,
+                              float* __restrict ax, float* __restrict ay, float* __restrict az,
+                              std::size_t targetCount) {
+    for (std::size_t k = 0; k < sourceCount; ++k) {
+        const float px = sx[k], py = sy[k], pz = sz[k], pm = sm[k];
+        for (std::size_t i = 0; i < targetCount; ++i) {
+            float dx = px - tx[i];
+            float dy = py - ty[i];
+            float dz = pz - tz[i];
+            float s = pm * law(dx * dx + dy * dy + dz * dz);
+            ax[i] += dx * s;
+            ay[i] += dy * s;
+            az[i] += dz * s;
+        }
+    }
+}
+
+// Symmetric kernel between the index ranges [aBegin, aEnd) and [bBegin, bEnd)
+// of one packed array: each pair is evaluated once and applied to both
+// bodies. Passing the same range twice handles every pair inside it.
+// Body i's own sum is a reduction, which the compiler will not reorder
+// without -ffast-math, so its terms are parked in a small block and added
+// in order afterwards; the loop doing the work stays free to vectorize and
+// the result matches a plain sequential sum.
+template <class Law>
+inline void accumulateMutual(const Law& law,
+                             const float* __restrict x, const float* __restrict y,
+                             const float* __restrict z, const float* __restrict m,
+                             float* __restrict ax, float* __restrict ay, float* __restrict az,
+                             std::uint32_t aBegin, std::uint32_t aEnd,
+                             std::uint32_t bBegin, std::uint32_t bEnd) {
+    constexpr std::uint32_t block = 64;
+    float termX[block], termY[block], termZ[block];
+    const bool same = aBegin == bBegin;
+    for (std::uint32_t i = aBegin; i < aEnd; ++i) {
+        const float xi = x[i], yi = y[i], zi = z[i], mi = m[i];
+        float sumX = 0.0f, sumY = 0.0f, sumZ = 0.0f;
+        for (std::uint32_t first = same ? i + 1 : bBegin; first < bEnd; first += block) {
+            const std::size_t count = std::min(block, bEnd - first);
+            for (std::size_t k = 0; k < count; ++k) {
+                const std::size_t j = first + k;
+                float dx = x[j] - xi;
+                float dy = y[j] - yi;
+                float dz = z[j] - zi;
+                float f = law(dx * dx + dy * dy + dz * dz);
+                termX[k] = dx * f * m[j];
+                termY[k] = dy * f * m[j];
+                termZ[k] = dz * f * m[j];
+                ax[j] -= dx * f * mi;
+                ay[j] -= dy * f * mi;
+                az[j] -= dz * f * mi;
+            }
+            for (std::size_t k = 0; k < count; ++k) {
+                sumX += termX[k];
+                sumY += termY[k];
+                sumZ += termZ[k];
+            }
+        }
+        ax[i] += sumX;
+        ay[i] += sumY;
+        az[i] += sumZ;
+    }
+}
@@ -0,0 +1,284 @@
+/*
+Headless batch runs: no window, no OpenGL, just the physics core.
+
+./GravitySimHeadless [options]
+  --config <file>     scene to run (default ../config/simulation.json)
+  --steps <n>         number of steps to run
+  --time <seconds>    simulated time to run instead of --steps
+  --dt <seconds>      timestep (default 0.016)
+  --every <n>         write the state every n steps (default: first and last only)
+  --output <file>     CSV file for the states (default trajectory.csv; with
+                      --trajectory, only written when given)
+  --trajectory <file> write the states to a memory-mappable trajectory file,
+                      on a writer thread so stepping continues during the I/O
+  --solver <name>     direct, tree or dualtree (default direct, or the
+                      checkpoint's solver with --restart)
+  --checkpoint <file> save the complete engine state at the end, and every
+                      --every steps, for resuming with --restart
+  --restart <file>    resume from a checkpoint instead of loading --config
+  --ensemble <file>   run the sweep described in file instead, one engine per
+                      member, and write a summary row per member to --output
+  --read <file>       list the frames of a trajectory file; with --frame <n>
+                      write frame n to --output as CSV instead
+*/
+#include "Checkpoint.hpp"
+#include "ConfigLoader.hpp"
+#include "Ensemble.hpp"
+#include "PhysicsEngine.hpp"
+#include "SceneSync.hpp"
+#include "SnapshotWriter.hpp"
+#include "TaskScheduler.hpp"
+#include "Trajectory.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+namespace {
+    struct Options {
+        std::string configPath = "../config/simulation.json";
+        std::string outputPath = "trajectory.csv";
+        std::string ensemblePath;
+        std::string checkpointPath;
+        std::string restartPath;
+        std::string trajectoryPath;
+        std::string readPath;
+        bool outputGiven = false;
+        std::int64_t frame = -1;
+        std::uint64_t steps = 0;
+        double time = 0.0;
+        float dt = 0.016f;
+        std::uint64_t every = 0;
+        PhysicsEngine::ForceSolver solver = PhysicsEngine::ForceSolver::DirectSum;
+        bool solverGiven = false;
+    };
+
+    void printUsage(const char* program) {
+        std::cerr << "Usage: " << program << " (--steps <n> | --time <seconds>) [--config <file>] [--dt <seconds>]"
+                  << " [--every <n>] [--output <file>] [--solver direct|tree|dualtree]"
+                  << " [--checkpoint <file>] [--restart <file>] [--trajectory <file>]" << std::endl;
+        std::cerr << "       " << program << " --ensemble <file> [--output <file>]" << std::endl;
+        std::cerr << "       " << program << " --read <file> [--frame <n> [--output <file>]]" << std::endl;
+    }
+
+    bool parseOptions(int argc, char** argv, Options& options) {
+        for (int i = 1; i < argc; ++i) {
+            const std::string arg = argv[i];
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for " << arg << std::endl;
+                return false;
+            }
+            const std::string value = argv[++i];
+            if (arg == "--config") {
+                options.configPath = value;
+            } else if (arg == "--output") {
+                options.outputPath = value;
+                options.outputGiven = true;
+            } else if (arg == "--ensemble") {
+                options.ensemblePath = value;
+            } else if (arg == "--checkpoint") {
+                options.checkpointPath = value;
+            } else if (arg == "--restart") {
+                options.restartPath = value;
+            } else if (arg == "--trajectory") {
+                options.trajectoryPath = value;
+            } else if (arg == "--read") {
+                options.readPath = value;
+            } else if (arg == "--frame") {
+                options.frame = std::strtoll(value.c_str(), nullptr, 10);
+            } else if (arg == "--steps") {
+                options.steps = std::strtoull(value.c_str(), nullptr, 10);
+            } else if (arg == "--time") {
+                options.time = std::strtod(value.c_str(), nullptr);
+            } else if (arg == "--dt") {
+                options.dt = std::strtof(value.c_str(), nullptr);
+            } else if (arg == "--every") {
+                options.every = std::strtoull(value.c_str(), nullptr, 10);
+            } else if (arg == "--solver") {
+                options.solverGiven = true;
+                if (value == "direct") {
+                    options.solver = PhysicsEngine::ForceSolver::DirectSum;
+                } else if (value == "tree") {
+                    options.solver = PhysicsEngine::ForceSolver::Tree;
+                } else if (value == "dualtree") {
+                    options.solver = PhysicsEngine::ForceSolver::DualTree;
+                } else {
+                    std::cerr << "Unknown solver: " << value << std::endl;
+                    return false;
+                }
+            } else {
+                std::cerr << "Unknown option: " << arg << std::endl;
+                return false;
+            }
+        }
+        if (options.dt <= 0.0f) {
+            std::cerr << "--dt must be positive" << std::endl;
+            return false;
+        }
+        if (!options.ensemblePath.empty() || !options.readPath.empty()) return true;    // nothing to step
+        if (options.steps == 0 && options.time > 0.0) {
+            options.steps = static_cast<std::uint64_t>(std::ceil(options.time / options.dt));
+        }
+        if (options.steps == 0) {
+            std::cerr << "Nothing to run: give --steps or --time" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // One row per body: handles identify a body across rows even after merges
+    // and restarts
+    void writeState(std::ostream& out, const PhysicsEngine& engine) {
+        const PhysicsEngine::StateView view = engine.view();
+        const std::uint64_t step = engine.getStepCount();
+        const double time = engine.getTime();
+        for (size_t i = 0; i < view.size(); ++i) {
+            const glm::vec3& p = view.positions[i];
+            const glm::vec3& v = view.velocities[i];
+            out << step << ',' << time << ',' << view.handles[i].slot << ',' << view.handles[i].generation << ','
+                << p.x << ',' << p.y << ',' << p.z << ',' << v.x << ',' << v.y << ',' << v.z << ','
+                << view.masses[i] << ',' << view.radii[i] << '\n';
+        }
+    }
+
+    // Same rows as writeState, from a frame of a trajectory file
+    void writeFrame(std::ostream& out, const TrajectoryReader::Frame& frame) {
+        using namespace TrajectoryFormat;
+        for (size_t i = 0; i < frame.bodyCount; ++i) {
+            out << frame.step << ',' << frame.time << ',' << frame.slots[i] << ',' << frame.generations[i];
+            for (std::uint32_t c = X; c < Slot; ++c) {
+                out << ',' << frame.columns[c][i];
+            }
+            out << '\n';
+        }
+    }
+
+    int readTrajectory(const Options& options) {
+        TrajectoryReader reader;
+        if (!reader.open(options.readPath)) return 1;
+        TrajectoryReader::Frame frame;
+        if (options.frame < 0) {
+            std::cout << reader.frameCount() << " frames in " << options.readPath
+                      << (reader.recovered() ? " (index rebuilt)" : "") << std::endl;
+            for (size_t i = 0; i < reader.frameCount() && reader.frame(i, frame); ++i) {
+                std::cout << i << ": step " << frame.step << ", t = " << frame.time << " s, " << frame.bodyCount
+                          << " bodies" << std::endl;
+            }
+            return 0;
+        }
+        if (!reader.frame(static_cast<size_t>(options.frame), frame)) {
+            std::cerr << "No frame " << options.frame << " in " << options.readPath << std::endl;
+            return 1;
+        }
+        std::ofstream out(options.outputPath);
+        out.precision(9);
+        out << "step,time,slot,generation,x,y,z,vx,vy,vz,mass,radius\n";
+        writeFrame(out, frame);
+        out.flush();
+        if (!out) {
+            std::cerr << "Failed to write output file: " << options.outputPath << std::endl;
+            return 1;
+        }
+        std::cout << "Frame " << options.frame << " (step " << frame.step << ") written to " << options.outputPath
+                  << std::endl;
+        return 0;
+    }
+
+    int runEnsemble(const Options& options) {
+        EnsembleSpec spec;
+        if (!Ensemble::loadSpec(options.ensemblePath, spec)) return 1;
+        const SimulationConfig base = ConfigLoader::loadConfig(spec.baseConfig);
+
+        std::cout << "Running " << Ensemble::memberCount(spec) << " members of " << base.objects.size()
+                  << " objects for " << spec.steps << " steps of " << spec.dt << " s" << std::endl;
+        const auto start = std::chrono::steady_clock::now();
+        std::vector<EnsembleResult> results;
+        if (!Ensemble::run(spec, base, results)) return 1;
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (!Ensemble::writeSummary(options.outputPath, spec, results)) return 1;
+
+        std::cout << "Finished in " << seconds << " s (" << results.size() / seconds << " members/s), summary written to "
+                  << options.outputPath << std::endl;
+        TaskScheduler::instance().printStats(std::cout);
+        return 0;
+    }
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    if (!options.ensemblePath.empty()) return runEnsemble(options);
+    if (!options.readPath.empty()) return readTrajectory(options);
+
+    PhysicsEngine engine;
+    if (!options.restartPath.empty()) {
+        if (!Checkpoint::load(options.restartPath, engine)) return 1;
+        std::cout << "Resuming at step " << engine.getStepCount() << " (t = " << engine.getTime() << " s) from "
+                  << options.restartPath << std::endl;
+        if (options.solverGiven) engine.setForceSolver(options.solver);
+    } else {
+        SimulationConfig config = ConfigLoader::loadConfig(options.configPath);
+        engine.setConfig(config.physics);
+        engine.setForceSolver(options.solver);
+        SceneSync scene;
+        scene.apply(config, engine);
+    }
+
+    const bool csv = options.outputGiven || options.trajectoryPath.empty();
+    std::ofstream out;
+    if (csv) {
+        out.open(options.outputPath);
+        if (!out) {
+            std::cerr << "Failed to open output file: " << options.outputPath << std::endl;
+            return 1;
+        }
+        out.precision(9);
+        out << "step,time,slot,generation,x,y,z,vx,vy,vz,mass,radius\n";
+    }
+    // Every frame is kept: with all buffers in flight the next step waits for the disk
+    SnapshotWriter trajectory;
+    if (!options.trajectoryPath.empty() && !trajectory.open(options.trajectoryPath)) return 1;
+    auto record = [&]() {
+        if (csv) writeState(out, engine);
+        return options.trajectoryPath.empty() || trajectory.submit(engine, SnapshotWriter::WhenFull::Wait);
+    };
+
+    std::cout << "Running " << engine.getBodies().size() << " bodies for " << options.steps << " steps of "
+              << options.dt << " s" << std::endl;
+    const auto start = std::chrono::steady_clock::now();
+    const std::uint64_t every = options.every > 0 ? options.every : options.steps;
+    if (!record()) return 1;
+    for (std::uint64_t done = 0; done < options.steps;) {
+        const std::uint64_t batch = std::min<std::uint64_t>({every - done % every, options.steps - done, 1u << 30});
+        engine.advance(options.dt, static_cast<unsigned>(batch));
+        done += batch;
+        if (!record()) return 1;
+        if (!options.checkpointPath.empty() && !Checkpoint::save(options.checkpointPath, engine)) return 1;
+    }
+    if (csv) {
+        out.flush();
+        if (!out) {
+            std::cerr << "Failed to write output file: " << options.outputPath << std::endl;
+            return 1;
+        }
+    }
+    if (!trajectory.close()) return 1;
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Finished in " << seconds << " s (" << options.steps / seconds << " steps/s), "
+              << engine.getBodies().size() << " bodies left, states written to " << (csv ? options.outputPath : options.trajectoryPath) << std::endl;
+    if (!options.trajectoryPath.empty()) {
+        const SnapshotWriter::Stats stats = trajectory.getStats();
+        std::cout << stats.written << " frames written through " << trajectory.backend() << ", stepping waited "
+                  << stats.waitSeconds << " s for the disk" << std::endl;
+    }
+    TaskScheduler::instance().printStats(std::cout);
+    return 0;
+}
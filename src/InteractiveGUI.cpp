@@ -6,6 +6,8 @@
 #endif
 #include <iostream>
 #include <algorithm>
+#include <cmath>
+#include <cstdio>
 
 // Static member definitions
 std::vector<GUIButton> InteractiveGUI::buttons;
@@ -19,6 +21,8 @@ double InteractiveGUI::mouseX = 0.0;
 double InteractiveGUI::mouseY = 0.0;
 bool InteractiveGUI::mousePressed = false;
 int InteractiveGUI::currentTab = 0;
+float InteractiveGUI::timeWarpExponent = 0.0f;
+float InteractiveGUI::simulationRate = 0.0f;
 
 void InteractiveGUI::init(GLFWwindow* window) {
     // Set up mouse callback
@@ -36,7 +40,7 @@ void InteractiveGUI::init(GLFWwindow* window) {
     });
 }
 
-void InteractiveGUI::render(SimulationConfig& config, bool& configChanged) {
+void InteractiveGUI::render(SimulationConfig& config, bool& configChanged, ConfigEdits& edits) {
     // Set up 2D rendering
     glMatrixMode(GL_PROJECTION);
     glPushMatrix();
@@ -56,10 +60,10 @@ void InteractiveGUI::render(SimulationConfig& config, bool& configChanged) {
     
     // Draw tab content based on current tab
     switch (currentTab) {
-        case 0: drawObjectsTab(config, configChanged); break;
+        case 0: drawObjectsTab(config, configChanged, edits); break;
         case 1: drawPhysicsTab(config, configChanged); break;
         case 2: drawVisualsTab(config, configChanged); break;
-        case 3: drawPresetsTab(config, configChanged); break;
+        case 3: drawPresetsTab(config, configChanged, edits); break;
     }
     
     // Restore 3D rendering
@@ -139,7 +143,7 @@ void InteractiveGUI::drawTabs() {
     }
 }
 
-void InteractiveGUI::drawObjectsTab(SimulationConfig& config, bool& configChanged) {
+void InteractiveGUI::drawObjectsTab(SimulationConfig& config, bool& configChanged, ConfigEdits& edits) {
     float yPos = windowY + 50;
     
     drawText(windowX + 10, yPos, "Objects: " + std::to_string(config.objects.size()));
@@ -178,12 +182,14 @@ void InteractiveGUI::drawObjectsTab(SimulationConfig& config, bool& configChange
         // Mass slider
         if (drawSlider(windowX + 10, yPos, 160, 15, "Mass", &obj.mass, 0.1f, 50.0f)) {
             configChanged = true;
+            edits.objects.push_back(i);
         }
         yPos += 25;
         
         // Radius slider
         if (drawSlider(windowX + 10, yPos, 160, 15, "Size", &obj.radius, 0.05f, 0.5f)) {
             configChanged = true;
+            edits.objects.push_back(i);
         }
         yPos += 25;
         
@@ -196,9 +202,11 @@ void InteractiveGUI::drawObjectsTab(SimulationConfig& config, bool& configChange
         // Position sliders
         if (drawSlider(windowX + 10, yPos, 50, 15, "X", &obj.position.x, -10.0f, 10.0f)) {
             configChanged = true;
+            edits.objects.push_back(i);
         }
         if (drawSlider(windowX + 70, yPos, 50, 15, "Z", &obj.position.z, -10.0f, 10.0f)) {
             configChanged = true;
+            edits.objects.push_back(i);
         }
         yPos += 35;
     }
@@ -233,6 +241,36 @@ void InteractiveGUI::drawPhysicsTab(SimulationConfig& config, bool& configChange
     if (drawSlider(windowX + 10, yPos, 160, 15, "Boundary", &config.physics.boundaryRadius, 5.0f, 20.0f)) {
         configChanged = true;
     }
+    yPos += 30;
+    
+    // Separate buttons rather than a toggle, since a held click repeats every frame
+    bool merging = config.physics.collisionMode == CollisionMode::Merge;
+    drawText(windowX + 10, yPos + 15, merging ? "Collisions: Merge" : "Collisions: Bounce");
+    yPos += 20;
+    if (drawButton(windowX + 10, yPos, 70, 20, "Bounce") && merging) {
+        config.physics.collisionMode = CollisionMode::Separate;
+        configChanged = true;
+    }
+    if (drawButton(windowX + 100, yPos, 70, 20, "Merge") && !merging) {
+        config.physics.collisionMode = CollisionMode::Merge;
+        configChanged = true;
+    }
+    yPos += 45;
+    
+    // Time warp on a log scale, 1x to 10000x; not part of the config
+    drawSlider(windowX + 10, yPos, 160, 15, "Warp 10^", &timeWarpExponent, 0.0f, 4.0f);
+    yPos += 20;
+    char rate[64];
+    std::snprintf(rate, sizeof(rate), "%.0fx, sim %.1f s/s", getTimeWarp(), simulationRate);
+    drawText(windowX + 10, yPos + 10, rate);
+}
+
+double InteractiveGUI::getTimeWarp() {
+    return std::pow(10.0, static_cast<double>(timeWarpExponent));
+}
+
+void InteractiveGUI::setSimulationRate(float simSecondsPerWallSecond) {
+    simulationRate = simSecondsPerWallSecond;
 }
 
 void InteractiveGUI::drawVisualsTab(SimulationConfig& config, bool& configChanged) {
@@ -261,7 +299,7 @@ void InteractiveGUI::drawVisualsTab(SimulationConfig& config, bool& configChange
     }
 }
 
-void InteractiveGUI::drawPresetsTab(SimulationConfig& config, bool& configChanged) {
+void InteractiveGUI::drawPresetsTab(SimulationConfig& config, bool& configChanged, ConfigEdits& edits) {
     float yPos = windowY + 50;
     
     drawText(windowX + 10, yPos, "Preset Configurations");
@@ -307,6 +345,7 @@ void InteractiveGUI::drawPresetsTab(SimulationConfig& config, bool& configChange
         config.objects.push_back(mars);
         
         configChanged = true;
+        edits.allObjects = true;
     }
     yPos += 40;
     
@@ -338,6 +377,7 @@ void InteractiveGUI::drawPresetsTab(SimulationConfig& config, bool& configChange
         config.objects.push_back(star2);
         
         configChanged = true;
+        edits.allObjects = true;
     }
     yPos += 40;
     
@@ -373,6 +413,7 @@ void InteractiveGUI::drawPresetsTab(SimulationConfig& config, bool& configChange
         }
         
         configChanged = true;
+        edits.allObjects = true;
     }
 }
 
@@ -29,8 +29,13 @@ struct GUIColorPicker {
 class InteractiveGUI {
 public:
     static void init(GLFWwindow* window);
-    static void render(SimulationConfig& config, bool& configChanged);
+    // configChanged is set for any edit; edits lists the objects that changed
+    static void render(SimulationConfig& config, bool& configChanged, ConfigEdits& edits);
     static void handleMouse(double xpos, double ypos, bool leftPressed);
+    // Simulated seconds per wall second chosen on the physics tab
+    static double getTimeWarp();
+    // Rate the simulation actually achieves, shown next to the warp control
+    static void setSimulationRate(float simSecondsPerWallSecond);
     static void shutdown();
     
 private:
@@ -41,13 +46,15 @@ private:
     static double mouseX, mouseY;
     static bool mousePressed;
     static int currentTab;
+    static float timeWarpExponent;  // warp = 10^exponent
+    static float simulationRate;
     
     static void drawWindow();
     static void drawTabs();
-    static void drawObjectsTab(SimulationConfig& config, bool& configChanged);
+    static void drawObjectsTab(SimulationConfig& config, bool& configChanged, ConfigEdits& edits);
     static void drawPhysicsTab(SimulationConfig& config, bool& configChanged);
     static void drawVisualsTab(SimulationConfig& config, bool& configChanged);
-    static void drawPresetsTab(SimulationConfig& config, bool& configChanged);
+    static void drawPresetsTab(SimulationConfig& config, bool& configChanged, ConfigEdits& edits);
     
     static bool drawButton(float x, float y, float width, float height, const std::string& label);
     static bool drawSlider(float x, float y, float width, float height, const std::string& label, float* value, float minVal, float maxVal);
@@ -0,0 +1,183 @@
+#include "Json.hpp"
+#include <cstdlib>
+
+namespace {
+    class Parser {
+    public:
+        explicit Parser(const std::string& text) : text(text) {}
+
+        bool parseDocument(JsonValue& out, std::string& error) {
+            if (!parseValue(out, 0) || (skipWhitespace(), pos != text.size())) {
+                if (message.empty()) message = "unexpected trailing characters";
+                error = message + " at offset " + std::to_string(pos);
+                return false;
+            }
+            return true;
+        }
+
+    private:
+        const std::string& text;
+        size_t pos = 0;
+        std::string message;
+
+        bool fail(const char* what) {
+            if (message.empty()) message = what;
+            return false;
+        }
+
+        void skipWhitespace() {
+            while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\n' || text[pos] == '\r')) {
+                ++pos;
+            }
+        }
+
+        bool consume(char c) {
+            skipWhitespace();
+            if (pos < text.size() && text[pos] == c) {
+                ++pos;
+                return true;
+            }
+            return false;
+        }
+
+        bool parseValue(JsonValue& out, int depth) {
+            if (depth > 64) return fail("nesting too deep");
+            skipWhitespace();
+            if (pos >= text.size()) return fail("unexpected end of input");
+
+            char c = text[pos];
+            if (c == '{') return parseObject(out, depth);
+            if (c == '[') return parseArray(out, depth);
+            if (c == '"') {
+                out.type = JsonValue::Type::String;
+                return parseString(out.string);
+            }
+            if (text.compare(pos, 4, "true") == 0) {
+                pos += 4;
+                out.type = JsonValue::Type::Bool;
+                out.boolean = true;
+                return true;
+            }
+            if (text.compare(pos, 5, "false") == 0) {
+                pos += 5;
+                out.type = JsonValue::Type::Bool;
+                out.boolean = false;
+                return true;
+            }
+            if (text.compare(pos, 4, "null") == 0) {
+                pos += 4;
+                out.type = JsonValue::Type::Null;
+                return true;
+            }
+            return parseNumber(out);
+        }
+
+        bool parseNumber(JsonValue& out) {
+            const char* begin = text.c_str() + pos;
+            char* end = nullptr;
+            double value = std::strtod(begin, &end);
+            if (end == begin) return fail("invalid value");
+            pos += static_cast<size_t>(end - begin);
+            out.type = JsonValue::Type::Number;
+            out.number = value;
+            return true;
+        }
+
+        bool parseString(std::string& out) {
+            ++pos; // opening quote
+            out.clear();
+            while (pos < text.size()) {
+                char c = text[pos++];
+                if (c == '"') return true;
+                if (c != '\\') {
+                    out += c;
+                    continue;
+                }
+                if (pos >= text.size()) break;
+                char e = text[pos++];
+                switch (e) {
+                    case 'n': out += '\n'; break;
+                    case 't': out += '\t'; break;
+                    case 'r': out += '\r'; break;
+                    case 'b': out += '\b'; break;
+                    case 'f': out += '\f'; break;
+                    case 'u': {
+                        // Basic multilingual plane only, encoded as UTF-8
+                        if (pos + 4 > text.size()) return fail("bad unicode escape");
+                        unsigned code = static_cast<unsigned>(std::strtoul(text.substr(pos, 4).c_str(), nullptr, 16));
+                        pos += 4;
+                        if (code < 0x80) {
+                            out += static_cast<char>(code);
+                        } else if (code < 0x800) {
+                            out += static_cast<char>(0xC0 | (code >> 6));
+                            out += static_cast<char>(0x80 | (code & 0x3F));
+                        } else {
+                            out += static_cast<char>(0xE0 | (code >> 12));
+                            out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                            out += static_cast<char>(0x80 | (code & 0x3F));
+                        }
+                        break;
+                    }
+                    default: out += e; break; // \" \\ \/
+                }
+            }
+            return fail("unterminated string");
+        }
+
+        bool parseArray(JsonValue& out, int depth) {
+            ++pos; // [
+            out.type = JsonValue::Type::Array;
+            if (consume(']')) return true;
+            do {
+                out.array.emplace_back();
+                if (!parseValue(out.array.back(), depth + 1)) return false;
+            } while (consume(','));
+            return consume(']') || fail("expected ',' or ']'");
+        }
+
+        bool parseObject(JsonValue& out, int depth) {
+            ++pos; // {
+            out.type = JsonValue::Type::Object;
+            if (consume('}')) return true;
+            do {
+                skipWhitespace();
+                if (pos >= text.size() || text[pos] != '"') return fail("expected object key");
+                std::string key;
+                if (!parseString(key)) return false;
+                if (!consume(':')) return fail("expected ':'");
+                out.object.emplace_back(std::move(key), JsonValue());
+                if (!parseValue(out.object.back().second, depth + 1)) return false;
+            } while (consume(','));
+            return consume('}') || fail("expected ',' or '}'");
+        }
+    };
+}
+
+bool JsonValue::parse(const std::string& text, JsonValue& out, std::string& error) {
+    out = JsonValue();
+    Parser parser(text);
+    return parser.parseDocument(out, error);
+}
+
+const JsonValue* JsonValue::find(const std::string& key) const {
+    if (type != Type::Object) return nullptr;
+    for (const auto& member : object) {
+        if (member.first == key) return &member.second;
+    }
+    return nullptr;
+}
+
+float JsonValue::getFloat(const std::string& key, float fallback) const {
+    const JsonValue* v = find(key);
+    return v && v->type == Type::Number ? static_cast<float>(v->number) : fallback;
+}
+
+bool JsonValue::getBool(const std::string& key, bool fallback) const {
+    const JsonValue* v = find(key);
+    return v && v->type == Type::Bool ? v->boolean : fallback;
+}
+
+std::string JsonValue::getString(const std::string& key, const std::string& fallback) const {
+    const JsonValue* v = find(key);
+    return v && v->type == Type::String ? v->string : fallback;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <string>
+#include <utility>
+#include <vector>
+
+// Minimal JSON document model, enough for the configuration files.
+// Objects keep their keys in file order.
+class JsonValue {
+public:
+    enum class Type { Null, Bool, Number, String, Array, Object };
+
+    Type type = Type::Null;
+    bool boolean = false;
+    double number = 0.0;
+    std::string string;
+    std::vector<JsonValue> array;
+    std::vector<std::pair<std::string, JsonValue>> object;
+
+    // Parses text into out; on failure returns false and describes the problem in error
+    static bool parse(const std::string& text, JsonValue& out, std::string& error);
+
+    bool isNumber() const { return type == Type::Number; }
+    bool isString() const { return type == Type::String; }
+    bool isArray() const { return type == Type::Array; }
+    bool isObject() const { return type == Type::Object; }
+
+    // Member lookup; nullptr if this is not an object or the key is missing
+    const JsonValue* find(const std::string& key) const;
+
+    // Typed reads of an object member, returning fallback when absent or mistyped
+    float getFloat(const std::string& key, float fallback) const;
+    bool getBool(const std::string& key, bool fallback) const;
+    std::string getString(const std::string& key, const std::string& fallback) const;
+};
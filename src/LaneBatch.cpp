@@ -0,0 +1,299 @@
+#include "LaneBatch.hpp"
+#include "ForceLaws.hpp"
+#include <algorithm>
+#include <cmath>
+#include <glm/glm.hpp>
+
+// The lane loops spell out the engine's glm expressions term by term, in
+// the same order, so each lane follows its engine bit for bit as long as
+// the compiler does not fuse multiply-adds differently in the two
+
+LaneBatch::LaneBatch(size_t bodyCount)
+    : bodyCount(bodyCount),
+      bodies(bodyCount),
+      accelerations(bodyCount),
+      closePairs(bodyCount * (bodyCount > 0 ? bodyCount - 1 : 0) / 2 * width),
+      pending(bodyCount * width) {
+}
+
+bool LaneBatch::supports(const PhysicsConfig& config) {
+    return config.periodicBoxSize <= 0.0f && config.externalFields.empty() && !config.continuousCollisions &&
+           config.collisionMode == CollisionMode::Separate;
+}
+
+bool LaneBatch::load(size_t lane, const PhysicsEngine& engine) {
+    const PhysicsConfig& physics = engine.getConfig();
+    const std::vector<Body>& source = engine.getBodies();
+    // The lanes always step the default law and no field beyond the config's
+    if (lane >= width || source.size() != bodyCount || !supports(physics) ||
+        engine.getForceSolver() != PhysicsEngine::ForceSolver::DirectSum || !engine.getForceLaw().isDefault() ||
+        engine.hasCustomExternalField()) {
+        return false;
+    }
+    for (size_t i = 0; i < bodyCount; ++i) {
+        const Body& b = source[i];
+        LaneBody& target = bodies[i];
+        target.position.x[lane] = b.position.x;
+        target.position.y[lane] = b.position.y;
+        target.position.z[lane] = b.position.z;
+        target.velocity.x[lane] = b.velocity.x;
+        target.velocity.y[lane] = b.velocity.y;
+        target.velocity.z[lane] = b.velocity.z;
+        target.mass[lane] = b.mass;
+        target.radius[lane] = b.radius;
+    }
+    config.gravityConstant[lane] = physics.gravityConstant;
+    config.damping[lane] = physics.damping;
+    config.maxVelocity[lane] = physics.maxVelocity;
+    config.minDistance[lane] = physics.minDistance;
+    config.boundaryRadius[lane] = physics.boundaryRadius;
+    config.orbitalCorrection[lane] = physics.orbitalCorrection && bodyCount >= 2 ? 1.0f : 0.0f;
+    random[lane] = engine.getRandom();
+    used = std::max(used, lane + 1);
+    return true;
+}
+
+void LaneBatch::store(size_t lane, std::vector<Body>& target) const {
+    target.resize(bodyCount);
+    for (size_t i = 0; i < bodyCount; ++i) {
+        const LaneBody& b = bodies[i];
+        target[i].position = glm::vec3(b.position.x[lane], b.position.y[lane], b.position.z[lane]);
+        target[i].velocity = glm::vec3(b.velocity.x[lane], b.velocity.y[lane], b.velocity.z[lane]);
+        target[i].mass = b.mass[lane];
+        target[i].radius = b.radius[lane];
+    }
+}
+
+void LaneBatch::advance(float dt, unsigned steps) {
+    if (used == 0) return;
+    padUnusedLanes();
+    for (unsigned k = 0; k < steps; ++k) {
+        step(dt);
+    }
+}
+
+// Spare lanes run a copy of lane 0, which keeps them finite
+void LaneBatch::padUnusedLanes() {
+    auto pad = [&](float* lanes) {
+        for (size_t l = used; l < width; ++l) lanes[l] = lanes[0];
+    };
+    for (auto& b : bodies) {
+        for (float* lanes : {b.position.x, b.position.y, b.position.z, b.velocity.x, b.velocity.y, b.velocity.z,
+                             b.mass, b.radius}) {
+            pad(lanes);
+        }
+    }
+    for (float* lanes : {config.gravityConstant, config.damping, config.maxVelocity, config.minDistance,
+                         config.boundaryRadius, config.orbitalCorrection}) {
+        pad(lanes);
+    }
+}
+
+void LaneBatch::step(float dt) {
+    const size_t n = bodyCount;
+    const ForceLaws::Plummer law;
+
+    // Gravity: every source in index order, the body's own zero term included
+    for (size_t i = 0; i < n; ++i) {
+        const LaneBody& target = bodies[i];
+        alignas(32) float ax[width] = {}, ay[width] = {}, az[width] = {};
+        for (size_t k = 0; k < n; ++k) {
+            const LaneBody& source = bodies[k];
+            for (size_t l = 0; l < width; ++l) {
+                float dx = source.position.x[l] - target.position.x[l];
+                float dy = source.position.y[l] - target.position.y[l];
+                float dz = source.position.z[l] - target.position.z[l];
+                float s = source.mass[l] * law(dx * dx + dy * dy + dz * dz);
+                ax[l] += dx * s;
+                ay[l] += dy * s;
+                az[l] += dz * s;
+            }
+        }
+        LaneVector& a = accelerations[i];
+        for (size_t l = 0; l < width; ++l) {
+            a.x[l] = ax[l] * config.gravityConstant[l];
+            a.y[l] = ay[l] * config.gravityConstant[l];
+            a.z[l] = az[l] * config.gravityConstant[l];
+        }
+    }
+
+    // Pairs closer than minDistance; both bodies wait for the collision before drifting
+    bool anyClose = false;
+    std::fill(pending.begin(), pending.end(), 0);
+    std::uint32_t* pairFlags = closePairs.data();
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = i + 1; j < n; ++j, pairFlags += width) {
+            const LaneBody& a = bodies[i];
+            const LaneBody& b = bodies[j];
+            std::uint32_t any = 0;
+            for (size_t l = 0; l < width; ++l) {
+                float dx = a.position.x[l] - b.position.x[l];
+                float dy = a.position.y[l] - b.position.y[l];
+                float dz = a.position.z[l] - b.position.z[l];
+                const float minDist = config.minDistance[l];
+                pairFlags[l] = (minDist > 0.0f) & (dx * dx + dy * dy + dz * dz < minDist * minDist);
+                any |= pairFlags[l];
+            }
+            if (any) {
+                anyClose = true;
+                for (size_t l = 0; l < width; ++l) {
+                    pending[i * width + l] |= pairFlags[l];
+                    pending[j * width + l] |= pairFlags[l];
+                }
+            }
+        }
+    }
+
+    // The engine's fused sweep: orbital correction, kick, damping, boundary,
+    // velocity clamp and drift. Branches become selects between the updated
+    // and the old value, which keeps the lane loop free of control flow.
+    alignas(32) float centerX[width], centerY[width], centerZ[width], centerMass[width];
+    for (size_t l = 0; l < width; ++l) {
+        centerX[l] = bodies[0].position.x[l];
+        centerY[l] = bodies[0].position.y[l];
+        centerZ[l] = bodies[0].position.z[l];
+        centerMass[l] = bodies[0].mass[l];
+    }
+    for (size_t i = 0; i < n; ++i) {
+        LaneBody& b = bodies[i];
+        const LaneVector& a = accelerations[i];
+        const std::uint32_t* held = &pending[i * width];
+        const bool orbiting = i > 0;
+        for (size_t l = 0; l < width; ++l) {
+            float px = b.position.x[l], py = b.position.y[l], pz = b.position.z[l];
+            float vx = b.velocity.x[l], vy = b.velocity.y[l], vz = b.velocity.z[l];
+
+            float rx = px - centerX[l], ry = py - centerY[l], rz = pz - centerZ[l];
+            float r2 = rx * rx + ry * ry + rz * rz;
+            float targetVelocity = std::sqrt(config.gravityConstant[l] * centerMass[l] / std::sqrt(r2));
+            float invRadius = 1.0f / std::sqrt(r2);
+            float tx = -(rz * invRadius) * targetVelocity;
+            float ty = 0.0f * targetVelocity;
+            float tz = (rx * invRadius) * targetVelocity;
+            const float keep = 1.0f - 0.01f;
+            bool moving = std::sqrt(vx * vx + vy * vy + vz * vz) > 0.1f;
+            bool correct = orbiting & (config.orbitalCorrection[l] != 0.0f);
+            float mixX = vx * keep + tx * 0.01f;
+            float mixY = vy * keep + ty * 0.01f;
+            float mixZ = vz * keep + tz * 0.01f;
+            float cx = moving ? mixX : tx;
+            float cy = moving ? mixY : ty;
+            float cz = moving ? mixZ : tz;
+            vx = correct ? cx : vx;
+            vy = correct ? cy : vy;
+            vz = correct ? cz : vz;
+
+            vx += a.x[l] * dt;
+            vy = 0.0f;
+            vz += a.z[l] * dt;
+
+            const float damping = config.damping[l];
+            vx *= damping;
+            vy *= damping;
+            vz *= damping;
+
+            const float wall = config.boundaryRadius[l];
+            float p2 = px * px + py * py + pz * pz;
+            float invLength = 1.0f / std::sqrt(p2);
+            float dirX = px * invLength, dirY = py * invLength, dirZ = pz * invLength;
+            float radialVel = vx * dirX + vy * dirY + vz * dirZ;
+            bool outside = (wall > 0.0f) & (std::sqrt(p2) > wall);
+            bool bounce = outside & (radialVel > 0);
+            float wallX = dirX * wall, wallY = dirY * wall, wallZ = dirZ * wall;
+            float bounceX = vx - dirX * radialVel * 0.5f;
+            float bounceY = vy - dirY * radialVel * 0.5f;
+            float bounceZ = vz - dirZ * radialVel * 0.5f;
+            px = outside ? wallX : px;
+            py = outside ? wallY : py;
+            pz = outside ? wallZ : pz;
+            vx = bounce ? bounceX : vx;
+            vy = bounce ? bounceY : vy;
+            vz = bounce ? bounceZ : vz;
+
+            const float maxVelocity = config.maxVelocity[l];
+            float v2 = vx * vx + vy * vy + vz * vz;
+            float invSpeed = 1.0f / std::sqrt(v2);
+            bool clamp = (maxVelocity > 0.0f) & (std::sqrt(v2) > maxVelocity);
+            float clampX = vx * invSpeed * maxVelocity;
+            float clampY = vy * invSpeed * maxVelocity;
+            float clampZ = vz * invSpeed * maxVelocity;
+            vx = clamp ? clampX : vx;
+            vy = clamp ? clampY : vy;
+            vz = clamp ? clampZ : vz;
+
+            bool drift = held[l] == 0;
+            float driftX = px + vx * dt, driftZ = pz + vz * dt;
+            px = drift ? driftX : px;
+            py = drift ? 0.0f : py;
+            pz = drift ? driftZ : pz;
+
+            b.position.x[l] = px;
+            b.position.y[l] = py;
+            b.position.z[l] = pz;
+            b.velocity.x[l] = vx;
+            b.velocity.y[l] = vy;
+            b.velocity.z[l] = vz;
+        }
+    }
+
+    if (anyClose) {
+        resolveCollisions(dt);
+    }
+}
+
+// Close encounters are rare, so they are resolved lane by lane with the
+// engine's scalar separation, in the engine's pair order
+void LaneBatch::resolveCollisions(float dt) {
+    const size_t n = bodyCount;
+    for (size_t l = 0; l < used; ++l) {
+        auto position = [&](size_t i) {
+            return glm::vec3(bodies[i].position.x[l], bodies[i].position.y[l], bodies[i].position.z[l]);
+        };
+        auto velocity = [&](size_t i) {
+            return glm::vec3(bodies[i].velocity.x[l], bodies[i].velocity.y[l], bodies[i].velocity.z[l]);
+        };
+        auto set = [&](size_t i, const glm::vec3& p, const glm::vec3& v) {
+            bodies[i].position.x[l] = p.x;
+            bodies[i].position.y[l] = p.y;
+            bodies[i].position.z[l] = p.z;
+            bodies[i].velocity.x[l] = v.x;
+            bodies[i].velocity.y[l] = v.y;
+            bodies[i].velocity.z[l] = v.z;
+        };
+        const float minDist = config.minDistance[l];
+        const std::uint32_t* pairFlags = closePairs.data();
+        for (size_t i = 0; i < n; ++i) {
+            for (size_t j = i + 1; j < n; ++j, pairFlags += width) {
+                if (!pairFlags[l]) continue;
+                glm::vec3 pi = position(i), pj = position(j);
+                glm::vec3 vi = velocity(i), vj = velocity(j);
+                glm::vec3 diff = pi - pj;
+                float dist = glm::length(diff);
+                if (dist >= minDist) continue;
+
+                glm::vec3 separation = glm::normalize(diff) * (minDist - dist);
+                pi += separation * 1.8f;
+                pj -= separation * 1.8f;
+                glm::vec3 normal = glm::normalize(diff);
+                float velDiff = glm::dot(vi - vj, normal);
+                if (velDiff < 0) {
+                    vi -= normal * velDiff * 1.0f;
+                    vj += normal * velDiff * 1.0f;
+                }
+                if (dist < minDist * 0.7f) {
+                    vi += glm::vec3(0.4f, 0.0f, 0.4f) * (float)(random[l].next() % 100) / 100.0f;
+                    vj += glm::vec3(0.4f, 0.0f, 0.4f) * (float)(random[l].next() % 100) / 100.0f;
+                }
+                set(i, pi, vi);
+                set(j, pj, vj);
+            }
+        }
+        // Drift of the bodies held back from the sweep
+        for (size_t i = 0; i < n; ++i) {
+            if (!pending[i * width + l]) continue;
+            glm::vec3 p = position(i) + velocity(i) * dt;
+            p.y = 0.0f;
+            set(i, p, velocity(i));
+        }
+    }
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include "ConfigLoader.hpp"
+#include "PhysicsEngine.hpp"
+#include "Random.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Steps up to width independent copies of one small scene together, one copy
+// per SIMD lane. Every per-body quantity is stored as width consecutive
+// floats, so the loops over lanes compile to single vector operations. A
+// scene of a handful of bodies is shorter than a vector and cannot fill the
+// vector units on its own; a batch of them can.
+//
+// Each lane reproduces PhysicsEngine::update with the direct-sum solver and
+// the default force law, and every lane has its own physics settings.
+// supports() tells which settings qualify. Bodies that come within
+// minDistance are separated one lane at a time.
+class LaneBatch {
+public:
+    static constexpr std::size_t width = 8;
+    // Beyond this the per-engine passes vectorize over bodies and run on several threads
+    static constexpr std::size_t maxBodies = 64;
+    using Body = PhysicsEngine::Body;
+
+    explicit LaneBatch(std::size_t bodyCount);
+
+    // No periodic box, external fields, continuous collisions or merging
+    static bool supports(const PhysicsConfig& config);
+
+    // Copies an engine's bodies, settings and random generator into a lane;
+    // false for an engine this batch would not reproduce, e.g. one with
+    // another force law. Lanes left unloaded mirror lane 0 and are never read back.
+    bool load(std::size_t lane, const PhysicsEngine& engine);
+    void advance(float dt, unsigned steps);
+    void store(std::size_t lane, std::vector<Body>& bodies) const;
+
+    std::size_t getBodyCount() const { return bodyCount; }
+
+private:
+    struct LaneVector {
+        alignas(32) float x[width];
+        alignas(32) float y[width];
+        alignas(32) float z[width];
+    };
+    // One body in every lane
+    struct LaneBody {
+        LaneVector position;
+        LaneVector velocity;
+        alignas(32) float mass[width];
+        alignas(32) float radius[width];
+    };
+    // The physics settings of every lane
+    struct LaneConfig {
+        alignas(32) float gravityConstant[width];
+        alignas(32) float damping[width];
+        alignas(32) float maxVelocity[width];
+        alignas(32) float minDistance[width];
+        alignas(32) float boundaryRadius[width];
+        alignas(32) float orbitalCorrection[width];   // 1 or 0
+    };
+
+    std::size_t bodyCount;
+    std::size_t used = 0;
+    std::vector<LaneBody> bodies;
+    LaneConfig config{};
+    SplitMix64 random[width];
+    // Accelerations of the current step, laid out like the positions
+    std::vector<LaneVector> accelerations;
+    // Per lane: collision flags of every pair (i < j), row by row, and
+    // whether the body is held back from the drift until they are resolved
+    std::vector<std::uint32_t> closePairs;
+    std::vector<std::uint32_t> pending;
+
+    void step(float dt);
+    void resolveCollisions(float dt);
+    void padUnusedLanes();
+};
@@ -0,0 +1,631 @@
+#include "Octree.hpp"
+#include <algorithm>
+#include <utility>
+
+// Spread the low 21 bits of v so that there are two zero bits between each
+static std::uint64_t spreadBits(std::uint64_t v) {
+    v &= 0x1fffff;
+    v = (v | v << 32) & 0x1f00000000ffffULL;
+    v = (v | v << 16) & 0x1f0000ff0000ffULL;
+    v = (v | v << 8) & 0x100f00f00f00f00fULL;
+    v = (v | v << 4) & 0x10c30c30c30c30c3ULL;
+    v = (v | v << 2) & 0x1249249249249249ULL;
+    return v;
+}
+
+static void setBounds(Octree::Node& node, const glm::vec3& lo, const glm::vec3& hi) {
+    node.boundsMin = lo;
+    node.boundsMax = hi;
+    node.radius = glm::length(glm::max(hi - node.centerOfMass, node.centerOfMass - lo));
+}
+
+// Sort chunks on separate tasks, then merge neighbouring runs pairwise
+template <class T>
+static void parallelSort(std::vector<T>& values, TaskScheduler& scheduler) {
+    const std::size_t chunks = std::max<std::size_t>(1, std::min<std::size_t>(scheduler.getThreadCount() * 4,
+                                                                              values.size() / 8192));
+    auto boundary = [&](std::size_t k) { return values.begin() + values.size() * std::min(k, chunks) / chunks; };
+    scheduler.parallelFor(chunks, 1, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t k = begin; k < end; ++k) {
+            std::sort(boundary(k), boundary(k + 1));
+        }
+    });
+    for (std::size_t width = 1; width < chunks; width *= 2) {
+        scheduler.parallelFor((chunks + 2 * width - 1) / (2 * width), 1, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t p = begin; p < end; ++p) {
+                std::inplace_merge(boundary(2 * width * p), boundary(2 * width * p + width),
+                                   boundary(2 * width * (p + 1)));
+            }
+        });
+    }
+}
+
+void Octree::finishBuild() {
+    TaskScheduler& scheduler = TaskScheduler::instance();
+    nodes.clear();
+    groups.clear();
+    upperNodes.clear();
+    subtreeRoots.clear();
+    scratch.resize(scheduler.getSlotCount());
+    const std::size_t count = pm.size();
+    order.resize(count);
+    if (count == 0) return;
+
+    // Root cube enclosing every body
+    glm::vec3 lo(px[0], py[0], pz[0]);
+    glm::vec3 hi = lo;
+    for (std::size_t i = 1; i < count; ++i) {
+        glm::vec3 p(px[i], py[i], pz[i]);
+        lo = glm::min(lo, p);
+        hi = glm::max(hi, p);
+    }
+    glm::vec3 center = (lo + hi) * 0.5f;
+    glm::vec3 extent = hi - lo;
+    float halfSize = std::max(std::max(extent.x, extent.y), extent.z) * 0.5f * 1.0001f + 1e-6f;
+
+    // Sort bodies along the Morton curve so every cell is a contiguous range
+    const float cells = static_cast<float>(1u << maxDepth);
+    const float scale = cells / (2.0f * halfSize);
+    const glm::vec3 origin = center - glm::vec3(halfSize);
+    std::vector<std::pair<std::uint64_t, std::uint32_t>> sorted(count);
+    scheduler.parallelFor(count, 16384, [&](std::size_t begin, std::size_t end) {
+        auto quantize = [cells](float v) {
+            return static_cast<std::uint64_t>(std::min(std::max(v, 0.0f), cells - 1.0f));
+        };
+        for (std::size_t i = begin; i < end; ++i) {
+            glm::vec3 p = (glm::vec3(px[i], py[i], pz[i]) - origin) * scale;
+            std::uint64_t key = spreadBits(quantize(p.x))
+                              | spreadBits(quantize(p.y)) << 1
+                              | spreadBits(quantize(p.z)) << 2;
+            sorted[i] = {key, static_cast<std::uint32_t>(i)};
+        }
+    });
+    parallelSort(sorted, scheduler);
+
+    keys.resize(count);
+    std::vector<float> sx(count), sy(count), sz(count), sm(count);
+    scheduler.parallelFor(count, 16384, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            std::uint32_t src = sorted[i].second;
+            keys[i] = sorted[i].first;
+            order[i] = src;
+            sx[i] = px[src];
+            sy[i] = py[src];
+            sz[i] = pz[src];
+            sm[i] = pm[src];
+        }
+    });
+    px.swap(sx);
+    py.swap(sy);
+    pz.swap(sz);
+    pm.swap(sm);
+
+    Node root{};
+    root.center = center;
+    root.halfSize = halfSize;
+    root.begin = 0;
+    root.end = static_cast<std::uint32_t>(count);
+    nodes.push_back(root);
+    buildTop(0, 0);
+
+    // Build the independent subtrees in parallel, each into its own node array
+    std::vector<std::vector<Node>> localNodes(subtreeRoots.size());
+    std::vector<std::vector<std::uint32_t>> localGroups(subtreeRoots.size());
+    scheduler.parallelFor(subtreeRoots.size(), 1, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t k = begin; k < end; ++k) {
+            localNodes[k].push_back(nodes[subtreeRoots[k].first]);
+            buildNode(localNodes[k], localGroups[k], 0, subtreeRoots[k].second, false);
+        }
+    });
+
+    // Splice them in: local node 0 replaces the placeholder, the rest are appended
+    for (std::size_t k = 0; k < subtreeRoots.size(); ++k) {
+        const std::uint32_t rootIndex = subtreeRoots[k].first;
+        const std::uint32_t base = static_cast<std::uint32_t>(nodes.size()) - 1;
+        auto relocate = [&](std::uint32_t local) { return local == 0 ? rootIndex : base + local; };
+        for (std::size_t i = 0; i < localNodes[k].size(); ++i) {
+            Node node = localNodes[k][i];
+            if (node.childCount > 0) node.firstChild = relocate(node.firstChild);
+            if (i == 0) {
+                nodes[rootIndex] = node;
+            } else {
+                nodes.push_back(node);
+            }
+        }
+        for (std::uint32_t g : localGroups[k]) {
+            groups.push_back(relocate(g));
+        }
+    }
+
+    // Upper levels were created parents-first, so summarize them in reverse
+    for (auto it = upperNodes.rbegin(); it != upperNodes.rend(); ++it) {
+        summarizeChildren(nodes, *it);
+    }
+}
+
+// Create the (empty) children of a node from the key bits of this level
+void Octree::splitNode(std::vector<Node>& out, std::uint32_t index, int level) {
+    const std::uint32_t begin = out[index].begin;
+    const std::uint32_t end = out[index].end;
+    const int shift = 3 * (maxDepth - 1 - level);
+    const float childHalf = out[index].halfSize * 0.5f;
+    const glm::vec3 center = out[index].center;
+    std::uint32_t firstChild = static_cast<std::uint32_t>(out.size());
+    std::uint32_t childCount = 0;
+    std::uint32_t i = begin;
+    while (i < end) {
+        std::uint32_t octant = static_cast<std::uint32_t>(keys[i] >> shift) & 7u;
+        std::uint32_t j = i;
+        while (j < end && (static_cast<std::uint32_t>(keys[j] >> shift) & 7u) == octant) ++j;
+
+        Node child{};
+        child.center = center + glm::vec3((octant & 1u) ? childHalf : -childHalf,
+                                          (octant & 2u) ? childHalf : -childHalf,
+                                          (octant & 4u) ? childHalf : -childHalf);
+        child.halfSize = childHalf;
+        child.begin = i;
+        child.end = j;
+        out.push_back(child);
+        ++childCount;
+        i = j;
+    }
+    out[index].firstChild = firstChild;
+    out[index].childCount = childCount;
+}
+
+// Split serially until ranges are small enough to become subtree tasks
+void Octree::buildTop(std::uint32_t index, int level) {
+    const std::uint32_t count = nodes[index].end - nodes[index].begin;
+    if (count <= taskCutoff || count <= groupSize || level >= maxDepth) {
+        subtreeRoots.emplace_back(index, level);
+        return;
+    }
+    upperNodes.push_back(index);
+    splitNode(nodes, index, level);
+    const std::uint32_t firstChild = nodes[index].firstChild;
+    const std::uint32_t childCount = nodes[index].childCount;
+    for (std::uint32_t c = 0; c < childCount; ++c) {
+        buildTop(firstChild + c, level + 1);
+    }
+}
+
+void Octree::buildNode(std::vector<Node>& out, std::vector<std::uint32_t>& outGroups,
+                       std::uint32_t index, int level, bool inGroup) {
+    const std::uint32_t count = out[index].end - out[index].begin;
+
+    if (!inGroup && count <= groupSize) {
+        outGroups.push_back(index);
+        inGroup = true;
+    }
+
+    if (count <= leafCapacity || level >= maxDepth) {
+        out[index].childCount = 0;
+        summarizeLeaf(out[index]);
+        return;
+    }
+
+    splitNode(out, index, level);
+    const std::uint32_t firstChild = out[index].firstChild;
+    const std::uint32_t childCount = out[index].childCount;
+    for (std::uint32_t c = 0; c < childCount; ++c) {
+        buildNode(out, outGroups, firstChild + c, level + 1, inGroup);
+    }
+    summarizeChildren(out, index);
+}
+
+// Monopole and bounds of a leaf, straight from its bodies
+void Octree::summarizeLeaf(Node& node) const {
+    glm::vec3 weighted(0.0f);
+    float mass = 0.0f;
+    glm::vec3 lo(px[node.begin], py[node.begin], pz[node.begin]);
+    glm::vec3 hi = lo;
+    for (std::uint32_t i = node.begin; i < node.end; ++i) {
+        glm::vec3 p(px[i], py[i], pz[i]);
+        weighted += p * pm[i];
+        mass += pm[i];
+        lo = glm::min(lo, p);
+        hi = glm::max(hi, p);
+    }
+    node.mass = mass;
+    node.centerOfMass = mass > 0.0f ? weighted / mass : node.center;
+    setBounds(node, lo, hi);
+}
+
+// Monopole and bounds of an internal node, from its children
+void Octree::summarizeChildren(std::vector<Node>& out, std::uint32_t index) {
+    const std::uint32_t firstChild = out[index].firstChild;
+    const std::uint32_t childCount = out[index].childCount;
+    glm::vec3 weighted(0.0f);
+    float mass = 0.0f;
+    glm::vec3 lo = out[firstChild].boundsMin;
+    glm::vec3 hi = out[firstChild].boundsMax;
+    for (std::uint32_t c = 0; c < childCount; ++c) {
+        const Node& child = out[firstChild + c];
+        weighted += child.centerOfMass * child.mass;
+        mass += child.mass;
+        lo = glm::min(lo, child.boundsMin);
+        hi = glm::max(hi, child.boundsMax);
+    }
+    out[index].mass = mass;
+    out[index].centerOfMass = mass > 0.0f ? weighted / mass : out[index].center;
+    setBounds(out[index], lo, hi);
+}
+
+void Octree::computeAccelerations(float gravityConstant, const ForceLaw& law, std::vector<glm::vec3>& out,
+                                  std::vector<std::uint32_t>& costs) {
+    TaskScheduler& scheduler = TaskScheduler::instance();
+    out.resize(order.size());
+
+    // Group costs vary a lot: predict them from last step's counts and give
+    // every worker a contiguous run of groups with the same total
+    const bool haveCosts = costs.size() == order.size();
+    groupCosts.resize(groups.size());
+    for (std::size_t g = 0; g < groups.size(); ++g) {
+        const Node& group = nodes[groups[g]];
+        std::uint64_t sum = 0;
+        for (std::uint32_t k = group.begin; k < group.end; ++k) {
+            sum += haveCosts ? costs[order[k]] : 1u;
+        }
+        groupCosts[g] = static_cast<std::uint32_t>(std::min<std::uint64_t>(sum, UINT32_MAX));
+    }
+    costs.resize(order.size());
+
+    std::vector<std::size_t> bounds = TaskScheduler::partitionByCost(groupCosts, scheduler.getThreadCount());
+    scheduler.parallelForRanges(bounds, [&](std::size_t begin, std::size_t end) {
+        WorkerScratch& s = scratch[scheduler.currentWorker()];
+        for (std::size_t g = begin; g < end; ++g) {
+            const Node& group = nodes[groups[g]];
+            walkGroup(group, s);
+
+            const std::uint32_t count = group.end - group.begin;
+            s.gx.assign(count, 0.0f);
+            s.gy.assign(count, 0.0f);
+            s.gz.assign(count, 0.0f);
+            // In a periodic box the walk has placed every source at its image
+            // nearest the group; groups too wide for that to hold for each of
+            // their bodies take the nearest image per pair instead
+            const glm::vec3 extent = group.boundsMax - group.boundsMin;
+            const bool wide = periodicBox > 0.0f &&
+                std::max(extent.x, std::max(extent.y, extent.z)) > 0.25f * periodicBox;
+            if (wide) {
+                law.accumulatePeriodic(periodicBox, s.list.x.data(), s.list.y.data(), s.list.z.data(),
+                                       s.list.m.data(), s.list.size(), px.data() + group.begin,
+                                       py.data() + group.begin, pz.data() + group.begin,
+                                       s.gx.data(), s.gy.data(), s.gz.data(), count);
+            } else {
+                law.accumulate(s.list.x.data(), s.list.y.data(), s.list.z.data(), s.list.m.data(), s.list.size(),
+                               px.data() + group.begin, py.data() + group.begin, pz.data() + group.begin,
+                               s.gx.data(), s.gy.data(), s.gz.data(), count);
+            }
+            if (periodicBox > 0.0f) {
+                addEwaldCorrection(group, wide, s);
+            }
+
+            const std::uint32_t interactions = static_cast<std::uint32_t>(s.list.size());
+            for (std::uint32_t k = 0; k < count; ++k) {
+                out[order[group.begin + k]] = glm::vec3(s.gx[k], s.gy[k], s.gz[k]) * gravityConstant;
+                costs[order[group.begin + k]] = interactions;
+            }
+        }
+    });
+}
+
+// Adds the far periodic images to a group's accelerations. The correction
+// varies on the scale of the box, so for a compact group it is evaluated at
+// the centre of mass and extrapolated to each body along its gradient.
+void Octree::addEwaldCorrection(const Node& group, bool wide, WorkerScratch& s) const {
+    const EwaldTable& ewald = EwaldTable::instance();
+    const InteractionList& list = s.list;
+    const std::uint32_t count = group.end - group.begin;
+    if (wide) {
+        for (std::uint32_t k = 0; k < count; ++k) {
+            const std::uint32_t slot = group.begin + k;
+            glm::vec3 c = ewald.accumulateNearest(list.x.data(), list.y.data(), list.z.data(), list.m.data(),
+                                                  list.size(), glm::vec3(px[slot], py[slot], pz[slot]), periodicBox);
+            s.gx[k] += c.x;
+            s.gy[k] += c.y;
+            s.gz[k] += c.z;
+        }
+        return;
+    }
+
+    auto correctionAt = [&](const glm::vec3& p) {
+        return ewald.accumulate(list.x.data(), list.y.data(), list.z.data(), list.m.data(), list.size(),
+                                p, periodicBox);
+    };
+    const glm::vec3 g = group.centerOfMass;
+    // Two table cells: wide enough to step over the trilinear kinks
+    const float h = 2.0f * EwaldTable::extent * periodicBox / EwaldTable::resolution;
+    const glm::vec3 c = correctionAt(g);
+    glm::vec3 slope[3];
+    for (int axis = 0; axis < 3; ++axis) {
+        glm::vec3 step(0.0f);
+        step[axis] = h;
+        slope[axis] = (correctionAt(g + step) - correctionAt(g - step)) / (2.0f * h);
+    }
+    for (std::uint32_t k = 0; k < count; ++k) {
+        const std::uint32_t slot = group.begin + k;
+        glm::vec3 ck = c + slope[0] * (px[slot] - g.x) + slope[1] * (py[slot] - g.y) + slope[2] * (pz[slot] - g.z);
+        s.gx[k] += ck.x;
+        s.gy[k] += ck.y;
+        s.gz[k] += ck.z;
+    }
+}
+
+// Collect every node and body the group interacts with into the shared list
+void Octree::walkGroup(const Node& group, WorkerScratch& s) const {
+    s.list.clear();
+    const glm::vec3 lo = group.boundsMin;
+    const glm::vec3 hi = group.boundsMax;
+    const glm::vec3 center = 0.5f * (lo + hi);
+
+    const float theta2 = openingAngle * openingAngle;
+    s.stack.clear();
+    s.stack.push_back(0);
+    while (!s.stack.empty()) {
+        const Node& node = nodes[s.stack.back()];
+        s.stack.pop_back();
+
+        // Distance from the node's centre of mass to the group's bounding box.
+        // In a periodic box the node is seen at its image nearest the group.
+        // The periodic sum does not depend on which image is used, as long
+        // as the Ewald correction is taken for the same one.
+        glm::vec3 com = node.centerOfMass;
+        if (periodicBox > 0.0f) {
+            com = center + Periodic::minimumImage(com - center, periodicBox);
+        }
+        glm::vec3 d = glm::max(glm::max(lo - com, com - hi), glm::vec3(0.0f));
+        float dist2 = glm::dot(d, d);
+        float size = 2.0f * node.halfSize;
+
+        if (size * size < theta2 * dist2) {
+            s.list.push(com.x, com.y, com.z, node.mass);
+        } else if (node.childCount == 0) {
+            for (std::uint32_t i = node.begin; i < node.end; ++i) {
+                if (periodicBox > 0.0f) {
+                    glm::vec3 p = center + Periodic::minimumImage(glm::vec3(px[i], py[i], pz[i]) - center, periodicBox);
+                    s.list.push(p.x, p.y, p.z, pm[i]);
+                } else {
+                    s.list.push(px[i], py[i], pz[i], pm[i]);
+                }
+            }
+        } else {
+            for (std::uint32_t c = 0; c < node.childCount; ++c) {
+                s.stack.push_back(node.firstChild + c);
+            }
+        }
+    }
+}
+
+void Octree::computeAccelerationsAndPairs(float gravityConstant, const ForceLaw& law, float collisionDistance,
+                                          std::vector<glm::vec3>& out,
+                                          std::vector<std::pair<std::uint32_t, std::uint32_t>>& pairs) {
+    TaskScheduler& scheduler = TaskScheduler::instance();
+    pairs.clear();
+    const std::size_t count = order.size();
+    out.resize(count);
+    if (count == 0) return;
+
+    walkLaw = &law;
+    walkCollisionDistance = collisionDistance;
+    ++dualWalk;
+
+    TaskScheduler::TaskGroup tasks;
+    interactSelf(0, dualScratch(), tasks);
+    scheduler.wait(tasks);
+
+    // Combine what the workers that took part accumulated; most of the
+    // slots for outside threads are never touched
+    dualUsed.clear();
+    for (const auto& s : scratch) {
+        if (s.dualWalk == dualWalk) dualUsed.push_back(&s);
+    }
+    accX.resize(count);
+    accY.resize(count);
+    accZ.resize(count);
+    scheduler.parallelFor(count, 16384, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t k = begin; k < end; ++k) {
+            float x = 0.0f, y = 0.0f, z = 0.0f;
+            for (const WorkerScratch* s : dualUsed) {
+                x += s->ax[k];
+                y += s->ay[k];
+                z += s->az[k];
+            }
+            accX[k] = x;
+            accY[k] = y;
+            accZ[k] = z;
+        }
+    });
+    locals.resize(nodes.size());
+    scheduler.parallelFor(nodes.size(), 4096, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t n = begin; n < end; ++n) {
+            LocalField sum{glm::vec3(0.0f), 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+            for (const WorkerScratch* s : dualUsed) {
+                const LocalField& f = s->locals[n];
+                sum.accel += f.accel;
+                sum.txx += f.txx;
+                sum.txy += f.txy;
+                sum.txz += f.txz;
+                sum.tyy += f.tyy;
+                sum.tyz += f.tyz;
+                sum.tzz += f.tzz;
+            }
+            locals[n] = sum;
+        }
+    });
+    for (const WorkerScratch* s : dualUsed) {
+        pairs.insert(pairs.end(), s->pairs.begin(), s->pairs.end());
+    }
+
+    passDown(0, tasks);
+    scheduler.wait(tasks);
+
+    scheduler.parallelFor(count, 16384, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t k = begin; k < end; ++k) {
+            out[order[k]] = glm::vec3(accX[k], accY[k], accZ[k]) * gravityConstant;
+        }
+    });
+    // Match the order of the i < j double loop so collisions resolve the same way
+    std::sort(pairs.begin(), pairs.end());
+}
+
+// The calling thread's scratch for the current dual-tree walk. It is
+// cleared by the first task that thread runs in the walk, so only the
+// workers that take part pay for it, and in parallel.
+Octree::WorkerScratch& Octree::dualScratch() {
+    WorkerScratch& s = scratch[TaskScheduler::instance().currentWorker()];
+    if (s.dualWalk != dualWalk) {
+        s.dualWalk = dualWalk;
+        s.ax.assign(order.size(), 0.0f);
+        s.ay.assign(order.size(), 0.0f);
+        s.az.assign(order.size(), 0.0f);
+        s.locals.assign(nodes.size(), LocalField{glm::vec3(0.0f), 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f});
+        s.pairs.clear();
+    }
+    return s;
+}
+
+void Octree::interactSelf(std::uint32_t a, WorkerScratch& s, TaskScheduler::TaskGroup& tasks) {
+    const Node& node = nodes[a];
+    if (node.childCount == 0) {
+        directPairs(a, a, s);
+        return;
+    }
+    const bool spawn = node.end - node.begin > taskCutoff;
+    TaskScheduler& scheduler = TaskScheduler::instance();
+    for (std::uint32_t i = 0; i < node.childCount; ++i) {
+        const std::uint32_t ci = node.firstChild + i;
+        if (spawn) {
+            scheduler.spawn(tasks, [this, ci, &tasks]() {
+                interactSelf(ci, dualScratch(), tasks);
+            });
+        } else {
+            interactSelf(ci, s, tasks);
+        }
+        for (std::uint32_t j = i + 1; j < node.childCount; ++j) {
+            const std::uint32_t cj = node.firstChild + j;
+            if (spawn) {
+                scheduler.spawn(tasks, [this, ci, cj, &tasks]() {
+                    interactNodes(ci, cj, dualScratch(), tasks);
+                });
+            } else {
+                interactNodes(ci, cj, s, tasks);
+            }
+        }
+    }
+}
+
+void Octree::interactNodes(std::uint32_t a, std::uint32_t b, WorkerScratch& s, TaskScheduler::TaskGroup& tasks) {
+    const Node& na = nodes[a];
+    const Node& nb = nodes[b];
+
+    // Far apart: both the monopole approximation and the absence of any
+    // close pair hold, so the interaction is folded into the local fields
+    glm::vec3 gap = glm::max(glm::max(na.boundsMin - nb.boundsMax, nb.boundsMin - na.boundsMax), glm::vec3(0.0f));
+    glm::vec3 d = nb.centerOfMass - na.centerOfMass;
+    float reach = na.radius + nb.radius;
+    if (reach * reach < dualOpeningAngle * dualOpeningAngle * glm::dot(d, d)
+        && glm::dot(gap, gap) > walkCollisionDistance * walkCollisionDistance) {
+        addFarField(a, nb, s);
+        addFarField(b, na, s);
+        return;
+    }
+
+    if (na.childCount == 0 && nb.childCount == 0) {
+        directPairs(a, b, s);
+        return;
+    }
+    // Split the larger node (or the only one that can be split)
+    const bool splitA = nb.childCount == 0 || (na.childCount != 0 && na.halfSize >= nb.halfSize);
+    const Node& parent = splitA ? na : nb;
+    const bool spawn = (na.end - na.begin) + (nb.end - nb.begin) > taskCutoff;
+    TaskScheduler& scheduler = TaskScheduler::instance();
+    for (std::uint32_t c = 0; c < parent.childCount; ++c) {
+        const std::uint32_t x = splitA ? parent.firstChild + c : a;
+        const std::uint32_t y = splitA ? b : parent.firstChild + c;
+        if (spawn) {
+            scheduler.spawn(tasks, [this, x, y, &tasks]() {
+                interactNodes(x, y, dualScratch(), tasks);
+            });
+        } else {
+            interactNodes(x, y, s, tasks);
+        }
+    }
+}
+
+// Accumulate the pull of source's monopole at target's centre of mass, with
+// its gradient. For a law a = m f(r^2) d the gradient is -m (f I + 2 f' d d^T).
+void Octree::addFarField(std::uint32_t target, const Node& source, WorkerScratch& s) const {
+    glm::vec3 d = source.centerOfMass - nodes[target].centerOfMass;
+    float r2 = glm::dot(d, d);
+    float f = source.mass * walkLaw->factor(r2);
+    float g = -2.0f * source.mass * walkLaw->derivative(r2);
+
+    LocalField& field = s.locals[target];
+    field.accel += d * f;
+    field.txx += g * d.x * d.x - f;
+    field.txy += g * d.x * d.y;
+    field.txz += g * d.x * d.z;
+    field.tyy += g * d.y * d.y - f;
+    field.tyz += g * d.y * d.z;
+    field.tzz += g * d.z * d.z - f;
+}
+
+// Exact pairwise interactions between two leaves (or within one leaf)
+void Octree::directPairs(std::uint32_t a, std::uint32_t b, WorkerScratch& s) const {
+    const Node& na = nodes[a];
+    const Node& nb = nodes[b];
+    walkLaw->accumulatePairs(px.data(), py.data(), pz.data(), pm.data(), s.ax.data(), s.ay.data(), s.az.data(),
+                             na.begin, na.end, nb.begin, nb.end);
+
+    const float collide2 = walkCollisionDistance * walkCollisionDistance;
+    for (std::uint32_t i = na.begin; i < na.end; ++i) {
+        for (std::uint32_t j = (a == b ? i + 1 : nb.begin); j < nb.end; ++j) {
+            float dx = px[j] - px[i];
+            float dy = py[j] - py[i];
+            float dz = pz[j] - pz[i];
+            if (dx * dx + dy * dy + dz * dz < collide2) {
+                std::uint32_t bi = order[i], bj = order[j];
+                s.pairs.emplace_back(std::min(bi, bj), std::max(bi, bj));
+            }
+        }
+    }
+}
+
+// Shift each node's local field to its children and finally onto its bodies
+void Octree::passDown(std::uint32_t index, TaskScheduler::TaskGroup& tasks) {
+    const Node& node = nodes[index];
+    const LocalField& field = locals[index];
+    auto evaluate = [&field](const glm::vec3& offset) {
+        return field.accel + glm::vec3(field.txx * offset.x + field.txy * offset.y + field.txz * offset.z,
+                                       field.txy * offset.x + field.tyy * offset.y + field.tyz * offset.z,
+                                       field.txz * offset.x + field.tyz * offset.y + field.tzz * offset.z);
+    };
+
+    if (node.childCount == 0) {
+        for (std::uint32_t i = node.begin; i < node.end; ++i) {
+            glm::vec3 a = evaluate(glm::vec3(px[i], py[i], pz[i]) - node.centerOfMass);
+            accX[i] += a.x;
+            accY[i] += a.y;
+            accZ[i] += a.z;
+        }
+        return;
+    }
+    TaskScheduler& scheduler = TaskScheduler::instance();
+    for (std::uint32_t c = 0; c < node.childCount; ++c) {
+        const std::uint32_t child = node.firstChild + c;
+        LocalField& target = locals[child];
+        target.accel += evaluate(nodes[child].centerOfMass - node.centerOfMass);
+        target.txx += field.txx;
+        target.txy += field.txy;
+        target.txz += field.txz;
+        target.tyy += field.tyy;
+        target.tyz += field.tyz;
+        target.tzz += field.tzz;
+        if (nodes[child].end - nodes[child].begin > taskCutoff) {
+            scheduler.spawn(tasks, [this, child, &tasks]() { passDown(child, tasks); });
+        } else {
+            passDown(child, tasks);
+        }
+    }
+}
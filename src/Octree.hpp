@@ -0,0 +1,147 @@
+#pragma once
+#include "ForceLaws.hpp"
+#include "TaskScheduler.hpp"
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Barnes-Hut octree over a Morton-sorted copy of the body positions.
+// Nodes with at most groupSize bodies form leaf groups: each group walks the
+// tree once, collects a shared interaction list and evaluates it with the
+// dense kernel of the chosen ForceLaw. Alternatively a dual-tree walk
+// evaluates gravity and finds close pairs for collisions in the same pass.
+class Octree {
+public:
+    struct Node {
+        glm::vec3 centerOfMass;
+        float mass;
+        glm::vec3 center;          // geometric centre of the cell
+        float halfSize;
+        glm::vec3 boundsMin, boundsMax; // tight box around the node's bodies
+        float radius;              // bounding sphere of the bodies about centerOfMass
+        std::uint32_t begin, end;  // body range in tree order
+        std::uint32_t firstChild;  // children are stored contiguously
+        std::uint32_t childCount;  // 0 for leaves
+    };
+
+    template <class BodyT>
+    void build(const std::vector<BodyT>& bodies);
+
+    // Writes G-scaled accelerations for every body, indexed like the input of build().
+    // costs holds last step's per-body interaction counts, used to split the
+    // groups evenly over the workers, and is overwritten with this step's counts.
+    void computeAccelerations(float gravityConstant, const ForceLaw& law, std::vector<glm::vec3>& out,
+                              std::vector<std::uint32_t>& costs);
+
+    // Dual-tree walk: computes the same accelerations and also reports every
+    // pair of bodies closer than collisionDistance, as sorted (i < j) body indices
+    void computeAccelerationsAndPairs(float gravityConstant, const ForceLaw& law, float collisionDistance,
+                                      std::vector<glm::vec3>& out,
+                                      std::vector<std::pair<std::uint32_t, std::uint32_t>>& pairs);
+
+    void setOpeningAngle(float theta) { openingAngle = theta; }
+    // The dual-tree walk has its own opening angle: it approximates both
+    // ends of an interaction, so at the same theta it is roughly ten times
+    // less accurate than the group walk (max error 9% of the RMS
+    // acceleration at 0.5 against 0.5%). The default of 0.2 brings its
+    // RMS error in line with the group walk at 0.5, at several times the cost.
+    static constexpr float defaultDualOpeningAngle = 0.2f;
+    void setDualOpeningAngle(float theta) { dualOpeningAngle = theta; }
+    void setGroupSize(std::size_t n) { groupSize = n > 0 ? n : 1; }
+    float getOpeningAngle() const { return openingAngle; }
+    float getDualOpeningAngle() const { return dualOpeningAngle; }
+    std::size_t getGroupSize() const { return groupSize; }
+    // Side of the periodic box for computeAccelerations(); 0 for open boundaries.
+    // Nodes are taken at their nearest image and forces get the Ewald correction.
+    void setPeriodicBox(float size) { periodicBox = size; }
+
+    const std::vector<Node>& getNodes() const { return nodes; }
+    const std::vector<std::uint32_t>& getGroups() const { return groups; }
+    std::size_t size() const { return order.size(); }
+
+private:
+    static constexpr std::uint32_t leafCapacity = 8;
+    static constexpr int maxDepth = 21; // bits per axis in the Morton key
+    // Subtrees and node pairs below this many bodies run as a single task
+    static constexpr std::uint32_t taskCutoff = 4096;
+
+    std::vector<Node> nodes;
+    std::vector<std::uint32_t> groups;  // node indices of the leaf groups
+    std::vector<std::uint32_t> order;   // tree slot -> body index
+    std::vector<float> px, py, pz, pm;  // bodies in tree order
+
+    float openingAngle = 0.5f;
+    float dualOpeningAngle = defaultDualOpeningAngle;
+    std::size_t groupSize = 64;
+    float periodicBox = 0.0f;
+
+    // Far-field expansion accumulated per node by the dual-tree walk:
+    // acceleration at the centre of mass plus its gradient (tidal tensor)
+    struct LocalField {
+        glm::vec3 accel;
+        float txx, txy, txz, tyy, tyz, tzz;
+    };
+
+    // Per-worker scratch so tasks never share accumulators
+    struct WorkerScratch {
+        InteractionList list;
+        std::vector<float> gx, gy, gz;      // group accelerations
+        std::vector<std::uint32_t> stack;
+        std::vector<float> ax, ay, az;      // dual-tree body accelerations (tree order)
+        std::vector<LocalField> locals;
+        std::vector<std::pair<std::uint32_t, std::uint32_t>> pairs;
+        std::uint64_t dualWalk = 0;         // walk the dual-tree arrays were last cleared for
+    };
+    std::vector<WorkerScratch> scratch;
+
+    std::vector<std::uint32_t> groupCosts;
+
+    // Build state
+    std::vector<std::uint64_t> keys;
+    std::vector<std::uint32_t> upperNodes;  // nodes split before the parallel subtrees
+    std::vector<std::pair<std::uint32_t, int>> subtreeRoots;
+
+    // Dual-tree walk state
+    std::vector<float> accX, accY, accZ;
+    std::vector<LocalField> locals;
+    const ForceLaw* walkLaw = nullptr;
+    float walkCollisionDistance = 0.0f;
+    std::uint64_t dualWalk = 0;
+    std::vector<const WorkerScratch*> dualUsed;     // scratch the last walk wrote to
+
+    void finishBuild();
+    void splitNode(std::vector<Node>& out, std::uint32_t index, int level);
+    void buildTop(std::uint32_t index, int level);
+    void buildNode(std::vector<Node>& out, std::vector<std::uint32_t>& outGroups,
+                   std::uint32_t index, int level, bool inGroup);
+    void summarizeLeaf(Node& node) const;
+    static void summarizeChildren(std::vector<Node>& out, std::uint32_t index);
+
+    void walkGroup(const Node& group, WorkerScratch& s) const;
+    void addEwaldCorrection(const Node& group, bool wide, WorkerScratch& s) const;
+
+    WorkerScratch& dualScratch();
+    void interactSelf(std::uint32_t a, WorkerScratch& s, TaskScheduler::TaskGroup& tasks);
+    void interactNodes(std::uint32_t a, std::uint32_t b, WorkerScratch& s, TaskScheduler::TaskGroup& tasks);
+    void addFarField(std::uint32_t target, const Node& source, WorkerScratch& s) const;
+    void directPairs(std::uint32_t a, std::uint32_t b, WorkerScratch& s) const;
+    void passDown(std::uint32_t index, TaskScheduler::TaskGroup& tasks);
+};
+
+template <class BodyT>
+void Octree::build(const std::vector<BodyT>& bodies) {
+    px.resize(bodies.size());
+    py.resize(bodies.size());
+    pz.resize(bodies.size());
+    pm.resize(bodies.size());
+    TaskScheduler::instance().parallelFor(bodies.size(), 16384, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            px[i] = bodies[i].position.x;
+            py[i] = bodies[i].position.y;
+            pz[i] = bodies[i].position.z;
+            pm[i] = bodies[i].mass;
+        }
+    });
+    finishBuild();
+}
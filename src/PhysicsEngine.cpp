@@ -1,124 +1,956 @@
 #include "PhysicsEngine.hpp"
+#include "TaskScheduler.hpp"
+#include "UpdateStages.hpp"
+#include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <glm/glm.hpp>
+#include <utility>
 
-void PhysicsEngine::addBody(const Body& b) {
+PhysicsEngine::BodyHandle PhysicsEngine::addBody(const Body& b) {
+    ++epoch;
     bodies.push_back(b);
+    neighbourAnchors.clear();
+    return bodySlots.insert();
 }
 
-// Calculate orbital velocity for circular orbit
-float calculateOrbitalVelocity(float centralMass, float radius, float gravityConstant) {
-    return sqrt(gravityConstant * centralMass / radius);
+size_t PhysicsEngine::addBodies(const Body* source, size_t count) {
+    ++epoch;
+    const size_t first = bodies.size();
+    bodies.resize(first + count);
+    Body* target = bodies.data() + first;
+    TaskScheduler::instance().parallelFor(count, 65536, [&](size_t begin, size_t end) {
+        std::copy(source + begin, source + end, target + begin);
+    });
+    bodySlots.insert(count);
+    neighbourAnchors.clear();
+    return first;
+}
+
+size_t PhysicsEngine::addBodies(const BodyColumns& columns, size_t count) {
+    ++epoch;
+    const size_t first = bodies.size();
+    bodies.resize(first + count);
+    Body* target = bodies.data() + first;
+    TaskScheduler::instance().parallelFor(count, 65536, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            target[i].position = glm::vec3(columns.x[i], columns.y[i], columns.z[i]);
+            target[i].velocity = glm::vec3(columns.vx[i], columns.vy[i], columns.vz[i]);
+            target[i].mass = columns.mass[i];
+            target[i].radius = columns.radius ? columns.radius[i] : 0.0f;
+        }
+    });
+    bodySlots.insert(count);
+    neighbourAnchors.clear();
+    return first;
+}
+
+void PhysicsEngine::reserveBodies(size_t count) {
+    bodies.reserve(count);
+    bodySlots.reserve(count);
+}
+
+bool PhysicsEngine::removeBody(BodyHandle handle) {
+    const std::uint32_t index = bodySlots.erase(handle);
+    if (index == SlotMap::npos) return false;
+    ++epoch;
+    // Mirror the slot map's swap-and-pop in every per-body array
+    const size_t last = bodies.size() - 1;
+    bodies[index] = bodies[last];
+    bodies.pop_back();
+    if (gravityCosts.size() == last + 1) {
+        gravityCosts[index] = gravityCosts[last];
+        gravityCosts.pop_back();
+    }
+    if (collisionCosts.size() == last + 1) {
+        collisionCosts[index] = collisionCosts[last];
+        collisionCosts.pop_back();
+    }
+    collisionPending.resize(bodies.size());
+    neighbourAnchors.clear();   // the moved body's lists are gone
+    return true;
+}
+
+PhysicsEngine::Body* PhysicsEngine::getBody(BodyHandle handle) {
+    const std::uint32_t index = bodySlots.find(handle);
+    if (index == SlotMap::npos) return nullptr;
+    ++epoch;    // the caller may write through the pointer
+    return &bodies[index];
+}
+
+const PhysicsEngine::Body* PhysicsEngine::getBody(BodyHandle handle) const {
+    const std::uint32_t index = bodySlots.find(handle);
+    return index == SlotMap::npos ? nullptr : &bodies[index];
+}
+
+PhysicsEngine::PhysicsEngine(const PhysicsConfig& config)
+    : config(config), externalField(ExternalField::fromConfig(config.externalFields)) {
+    prepareEwaldTable();
 }
 
 void PhysicsEngine::update(float dt) {
-    // Calculate orbital velocities for bodies that should be orbiting
-    if (bodies.size() >= 2) {
-        float centralMass = bodies[0].mass;
-        float gravityConstant = 0.02f; // Adjusted for stable orbits
-        
-        // Update orbital velocities for orbiting bodies
-        for (size_t i = 1; i < bodies.size(); ++i) {
-            float currentRadius = glm::length(bodies[i].position - bodies[0].position);
-            float targetVelocity = calculateOrbitalVelocity(centralMass, currentRadius, gravityConstant);
-            
-            // Get current velocity direction
-            glm::vec3 currentVel = bodies[i].velocity;
-            float currentSpeed = glm::length(currentVel);
-            
-            // Calculate tangential direction (perpendicular to radial direction)
-            glm::vec3 radialDir = glm::normalize(bodies[i].position - bodies[0].position);
-            glm::vec3 tangentialDir = glm::vec3(-radialDir.z, 0.0f, radialDir.x); // Perpendicular in XZ plane
-            
-            // Adjust velocity to maintain orbital motion
-            if (currentSpeed > 0.1f) {
-                // Gradually adjust toward orbital velocity
-                glm::vec3 targetVel = tangentialDir * targetVelocity;
-                bodies[i].velocity = glm::mix(currentVel, targetVel, 0.01f);
-            } else {
-                // If nearly stationary, set initial orbital velocity
-                bodies[i].velocity = tangentialDir * targetVelocity;
+    advance(dt, 1);
+}
+
+void PhysicsEngine::advance(float dt, unsigned steps) {
+    if (steps == 0) return;
+    ++epoch;
+    // A scene this small stays in one core's cache from step to step, and
+    // handing its passes to the workers would cost more than they save
+    serialPasses = bodies.size() <= serialBodyLimit;
+    for (unsigned k = 0; k < steps; ++k) {
+        step(dt);
+    }
+    serialPasses = false;
+}
+
+void PhysicsEngine::step(float dt) {
+    const float gravityConstant = config.gravityConstant;
+    const float minDist = config.minDistance;
+    const bool continuous = config.continuousCollisions;
+    const bool collisions = !continuous && minDist > 0.0f;
+    
+    const bool periodic = config.periodicBoxSize > 0.0f;
+    // The dual-tree walk has no periodic images; the group walk stands in for it
+    const ForceSolver solver = periodic && forceSolver == ForceSolver::DualTree ? ForceSolver::Tree : forceSolver;
+    
+    // Pass 1 only reads positions: gravity plus the collision candidates.
+    // Unlike the original update loop, which tested for collisions after the
+    // boundary stage, candidates are found here on the positions the step
+    // starts from, so the fused sweep below can stay one pass. Resolution
+    // still sees the clamped positions and re-checks the distance, so a pair
+    // the wall pulls apart is skipped; a pair the wall pushes together is
+    // only caught on the next step.
+    if (solver == ForceSolver::DualTree) {
+        // One traversal yields both gravity and the collision candidates
+        tree.build(bodies);
+        tree.computeAccelerationsAndPairs(gravityConstant, forceLaw, collisions ? minDist : 0.0f, accelerations, closePairs);
+    } else {
+        if (solver == ForceSolver::Tree) {
+            computeTreeAccelerations(gravityConstant);
+        } else {
+            computeDirectAccelerations(gravityConstant);
+        }
+        closePairs.clear();
+        if (collisions) {
+            findCollisionPairs(minDist);
+        }
+    }
+    
+    // Pass 2 fuses every per-body stage into one sweep. Bodies with a pending
+    // collision are drifted only after it has been resolved.
+    collisionPending.resize(bodies.size());
+    for (const auto& pair : closePairs) {
+        collisionPending[pair.first] = 1;
+        collisionPending[pair.second] = 1;
+    }
+    
+    // Pick the kernel instantiation that leaves out every disabled feature.
+    // The periodic box replaces the spherical wall.
+    using Kernel = void (PhysicsEngine::*)(float);
+    static constexpr Kernel kernels[12] = {
+        &PhysicsEngine::integrate<false, false, false, false>, &PhysicsEngine::integrate<true, false, false, false>,
+        &PhysicsEngine::integrate<false, true, false, false>, &PhysicsEngine::integrate<true, true, false, false>,
+        &PhysicsEngine::integrate<false, false, true, false>, &PhysicsEngine::integrate<true, false, true, false>,
+        &PhysicsEngine::integrate<false, true, true, false>, &PhysicsEngine::integrate<true, true, true, false>,
+        &PhysicsEngine::integrate<false, false, false, true>, &PhysicsEngine::integrate<true, false, false, true>,
+        &PhysicsEngine::integrate<false, true, false, true>, &PhysicsEngine::integrate<true, true, false, true>,
+    };
+    const bool useDamping = config.damping != 1.0f;
+    const bool useClamp = config.maxVelocity > 0.0f;
+    const int boundaryMode = periodic ? 8 : (config.boundaryRadius > 0.0f ? 4 : 0);
+    (this->*kernels[(useDamping ? 1 : 0) | (useClamp ? 2 : 0) | boundaryMode])(dt);
+    
+    bool merged = false;
+    if (continuous) {
+        // Every body has moved along a straight line this step; find where
+        // those paths first touch
+        findSweptCollisions(dt);
+        if (config.collisionMode == CollisionMode::Merge) {
+            // The merged body's centre of mass moves with the total momentum,
+            // so merging the end-of-step positions lands it on the right path
+            closePairs.clear();
+            for (const auto& contact : contacts) {
+                closePairs.emplace_back(contact.first, contact.second);
+            }
+            std::sort(closePairs.begin(), closePairs.end());
+            merged = mergeCollidingBodies();
+            closePairs.clear();
+        } else {
+            // Earliest contact first; a body takes part in one contact per step.
+            // collisionPending is all clear here and is borrowed to mark them.
+            for (const auto& contact : contacts) {
+                if (collisionPending[contact.first] || collisionPending[contact.second]) continue;
+                collisionPending[contact.first] = 1;
+                collisionPending[contact.second] = 1;
+                resolveContact(contact, dt);
             }
+            for (const auto& contact : contacts) {
+                collisionPending[contact.first] = 0;
+                collisionPending[contact.second] = 0;
+            }
+        }
+    } else if (config.collisionMode == CollisionMode::Merge) {
+        merged = mergeCollidingBodies();
+    } else {
+        // Handle collisions between bodies - extremely aggressive separation
+        for (const auto& pair : closePairs) {
+            resolveCollision(pair.first, pair.second, minDist);
         }
     }
     
-    for (size_t i = 0; i < bodies.size(); ++i) {
-        glm::vec3 accel(0.0f);
-        for (size_t j = 0; j < bodies.size(); ++j) {
-            if (i != j) {
-            glm::vec3 dir=bodies[j].position - bodies[i].position;
-            float dist2 = glm::dot(dir, dir) + 1e-6f;
-            float invDist = 1.0f / sqrt(dist2);
-            // Use the same gravity constant as orbital calculations
-            float force = 0.02f * bodies[i].mass * bodies[j].mass * invDist * invDist;
-            accel += glm::normalize(dir) * (force/bodies[i].mass);
+    // Sparse drift of the bodies held back above
+    UpdateStages::Drift finish{dt};
+    for (const auto& pair : closePairs) {
+        for (std::uint32_t i : {pair.first, pair.second}) {
+            if (collisionPending[i]) {
+                finish(bodies[i], i);
+                wrapBody(i);
+                collisionPending[i] = 0;
             }
         }
+    }
+    
+    if (merged) {
+        compactBodies();
+    }
+    ++stepCount;
+    time += dt;
+}
+
+template <bool UseDamping, bool UseClamp, bool UseBoundary, bool UsePeriodic>
+void PhysicsEngine::integrate(float dt) {
+    UpdateStages::Kick kick{accelerations.data(), dt};
+    UpdateStages::Optional<UseDamping, UpdateStages::Damping> damping{{config.damping}};
+    UpdateStages::Optional<UseBoundary, UpdateStages::Boundary> boundary{{config.boundaryRadius}};
+    UpdateStages::Optional<UseClamp, UpdateStages::VelocityClamp> clamp{{config.maxVelocity}};
+    UpdateStages::Drift drift{dt, collisionPending.data()};
+    UpdateStages::Optional<UsePeriodic, UpdateStages::PeriodicWrap> wrap{{config.periodicBoxSize}};
+    auto run = [&](const auto&... stages) {
+        if (!externalField) {
+            UpdateStages::parallelSweep(bodies, stages...);
+            return;
+        }
+        // The background field is added a block at a time just ahead of the
+        // sweep that consumes it, so the block is still in cache
+        TaskScheduler::instance().parallelFor(bodies.size(), 16384, [&](size_t begin, size_t end) {
+            const size_t blockSize = 256;
+            for (size_t block = begin; block < end; block += blockSize) {
+                const size_t blockEnd = std::min(block + blockSize, end);
+                externalField.accumulate(&bodies[block].position, sizeof(Body), accelerations.data() + block,
+                                         blockEnd - block, config.gravityConstant);
+                UpdateStages::sweep(bodies, block, blockEnd, stages...);
+            }
+        });
+    };
+    if (config.orbitalCorrection && bodies.size() >= 2) {
+        // Calculate orbital velocities for bodies that should be orbiting
+        UpdateStages::OrbitalCorrection correction{bodies[0].position, bodies[0].mass, config.gravityConstant};
+        run(correction, kick, damping, boundary, clamp, drift, wrap);
+    } else {
+        run(kick, damping, boundary, clamp, drift, wrap);
+    }
+}
+
+glm::vec3 PhysicsEngine::separation(const glm::vec3& pi, const glm::vec3& pj) const {
+    if (config.periodicBoxSize > 0.0f) {
+        return Periodic::minimumImage(pi - pj, config.periodicBoxSize);
+    }
+    return pi - pj;
+}
+
+void PhysicsEngine::wrapBody(size_t i) {
+    if (config.periodicBoxSize > 0.0f) {
+        bodies[i].position = Periodic::wrap(bodies[i].position, config.periodicBoxSize);
+    }
+}
+
+void PhysicsEngine::resolveCollision(size_t i, size_t j, float minDist) {
+    glm::vec3 diff = separation(bodies[i].position, bodies[j].position);
+    float dist = glm::length(diff);
+    
+    if (dist < minDist) {
+        // Separate bodies very aggressively to prevent any overlap
+        glm::vec3 separation = glm::normalize(diff) * (minDist - dist);
+        bodies[i].position += separation * 1.8f;
+        bodies[j].position -= separation * 1.8f;
         
-        // Constrain movement to XZ plane (Y = 0)
-        accel.y = 0.0f;
-        bodies[i].velocity.y = 0.0f;
-        
-        bodies[i].velocity += accel * dt;
-        
-        // Add some damping to prevent chaotic behavior
-        bodies[i].velocity *= 0.999f;
+        // Bounce velocities very strongly to prevent sticking
+        glm::vec3 normal = glm::normalize(diff);
+        float velDiff = glm::dot(bodies[i].velocity - bodies[j].velocity, normal);
+        if (velDiff < 0) {
+            bodies[i].velocity -= normal * velDiff * 1.0f;
+            bodies[j].velocity += normal * velDiff * 1.0f;
+        }
         
-        // Keep objects within bounds (prevent them from flying off screen)
-        const float maxDistance = 12.0f;
-        if (glm::length(bodies[i].position) > maxDistance) {
-            glm::vec3 direction = glm::normalize(bodies[i].position);
-            bodies[i].position = direction * maxDistance;
-            // Reverse velocity component away from center
-            float radialVel = glm::dot(bodies[i].velocity, direction);
-            if (radialVel > 0) {
-                bodies[i].velocity -= direction * radialVel * 0.5f;
+        // Add significant random velocity to break out of stuck states
+        if (dist < minDist * 0.7f) {
+            bodies[i].velocity += glm::vec3(0.4f, 0.0f, 0.4f) * (float)(random.next() % 100) / 100.0f;
+            bodies[j].velocity += glm::vec3(0.4f, 0.0f, 0.4f) * (float)(random.next() % 100) / 100.0f;
+        }
+        wrapBody(i);
+        wrapBody(j);
+    }
+}
+
+// Swept-sphere collision detection over the step just integrated. Each body
+// moved from position - velocity * dt to position; the broad phase sorts the
+// bounding boxes of those paths along x and sweeps for overlaps, and the
+// candidates are packed and tested in bulk for their time of impact. In a
+// periodic box the sweep continues into the next image along x, boxes are
+// compared at their nearest image along y and z, and each pair is tested
+// from the nearest image of its end-of-step separation.
+void PhysicsEngine::findSweptCollisions(float dt) {
+    TaskScheduler& scheduler = TaskScheduler::instance();
+    const size_t count = bodies.size();
+    sweptBoxes.resize(count);
+    sweepOrder.resize(count);
+    scheduler.parallelFor(count, 16384, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            const Body& b = bodies[i];
+            glm::vec3 start = b.position - b.velocity * dt;
+            glm::vec3 reach(b.radius);
+            sweptBoxes[i] = {glm::min(start, b.position) - reach, glm::max(start, b.position) + reach};
+            sweepOrder[i] = static_cast<std::uint32_t>(i);
+        }
+    });
+    std::sort(sweepOrder.begin(), sweepOrder.end(), [&](std::uint32_t a, std::uint32_t b) {
+        return sweptBoxes[a].min.x < sweptBoxes[b].min.x;
+    });
+
+    workerSweeps.resize(scheduler.getSlotCount());
+    for (auto& list : workerSweeps) {
+        list.clear();
+    }
+    // Past the end of the order the sweep wraps to the bodies before k, one
+    // box length further along x, so no body meets its own image
+    const float box = config.periodicBoxSize;
+    const bool periodic = box > 0.0f;
+    auto apart = [&](float minA, float maxA, float minB, float maxB) {
+        if (!periodic) return minA > maxB || minB > maxA;
+        const float gap = Periodic::wrap(0.5f * (minB + maxB - minA - maxA), box);
+        return std::fabs(gap) > 0.5f * (maxA - minA + maxB - minB);
+    };
+    scheduler.parallelFor(count, 1024, [&](size_t begin, size_t end) {
+        SweptPairList& list = workerSweeps[scheduler.currentWorker()];
+        for (size_t k = begin; k < end; ++k) {
+            const std::uint32_t a = sweepOrder[k];
+            const SweptBox& boxA = sweptBoxes[a];
+            const size_t sweepEnd = periodic ? count + k : count;
+            for (size_t m = k + 1; m < sweepEnd; ++m) {
+                const std::uint32_t b = sweepOrder[m < count ? m : m - count];
+                const SweptBox& boxB = sweptBoxes[b];
+                if (boxB.min.x + (m < count ? 0.0f : box) > boxA.max.x) {
+                    // Paths reach past the box faces, so the wrapped run may
+                    // still start within reach
+                    if (m >= count || !periodic) break;
+                    m = count - 1;
+                    continue;
+                }
+                if (apart(boxA.min.y, boxA.max.y, boxB.min.y, boxB.max.y) ||
+                    apart(boxA.min.z, boxA.max.z, boxB.min.z, boxB.max.z)) {
+                    continue;
+                }
+                const std::uint32_t i = std::min(a, b);
+                const std::uint32_t j = std::max(a, b);
+                const Body& bi = bodies[i];
+                const Body& bj = bodies[j];
+                glm::vec3 move = (bi.velocity - bj.velocity) * dt;
+                glm::vec3 start = separation(bi.position, bj.position) - move;
+                list.push(i, j, start.x, start.y, start.z, move.x, move.y, move.z, bi.radius + bj.radius);
             }
         }
-        
-        // Limit maximum velocity to prevent chaos
-        float maxVel = 1.2f;
-        if (glm::length(bodies[i].velocity) > maxVel) {
-            bodies[i].velocity = glm::normalize(bodies[i].velocity) * maxVel;
+    });
+
+    // Narrow phase, one packed batch per worker; small scenes stay on this thread
+    auto narrowPhase = [&](size_t begin, size_t end) {
+        for (size_t w = begin; w < end; ++w) {
+            sweptSphereTimes(workerSweeps[w]);
         }
+    };
+    if (serialPasses) {
+        narrowPhase(0, workerSweeps.size());
+    } else {
+        scheduler.parallelFor(workerSweeps.size(), 1, narrowPhase);
     }
-    
-    // Handle collisions between bodies - extremely aggressive separation
-    for (size_t i = 0; i < bodies.size(); ++i) {
-        for (size_t j = i + 1; j < bodies.size(); ++j) {
-            glm::vec3 diff = bodies[i].position - bodies[j].position;
-            float dist = glm::length(diff);
-            float minDist = 1.2f; // Much larger minimum distance between bodies
-            
-            if (dist < minDist) {
-                // Separate bodies very aggressively to prevent any overlap
-                glm::vec3 separation = glm::normalize(diff) * (minDist - dist);
-                bodies[i].position += separation * 1.8f;
-                bodies[j].position -= separation * 1.8f;
-                
-                // Bounce velocities very strongly to prevent sticking
-                glm::vec3 normal = glm::normalize(diff);
-                float velDiff = glm::dot(bodies[i].velocity - bodies[j].velocity, normal);
-                if (velDiff < 0) {
-                    bodies[i].velocity -= normal * velDiff * 1.0f;
-                    bodies[j].velocity += normal * velDiff * 1.0f;
+
+    contacts.clear();
+    for (const auto& list : workerSweeps) {
+        for (size_t k = 0; k < list.size(); ++k) {
+            if (list.toi[k] <= 1.0f) {
+                contacts.push_back({list.first[k], list.second[k], list.toi[k]});
+            }
+        }
+    }
+    std::sort(contacts.begin(), contacts.end(), [](const Contact& a, const Contact& b) {
+        if (a.time != b.time) return a.time < b.time;
+        return std::make_pair(a.first, a.second) < std::make_pair(b.first, b.second);
+    });
+    if (periodic) {
+        // Paths longer than half the box can meet both directly and through the wrap
+        contacts.erase(std::unique(contacts.begin(), contacts.end(), [](const Contact& a, const Contact& b) {
+            return a.time == b.time && a.first == b.first && a.second == b.second;
+        }), contacts.end());
+    }
+}
+
+// Elastic bounce at the moment of contact. Both bodies are rewound to where
+// they touched, exchange momentum along the contact normal and then travel
+// the rest of the step with their new velocities.
+void PhysicsEngine::resolveContact(const Contact& contact, float dt) {
+    Body& a = bodies[contact.first];
+    Body& b = bodies[contact.second];
+    const float remaining = (1.0f - contact.time) * dt;
+    glm::vec3 touchA = a.position - a.velocity * remaining;
+    glm::vec3 touchB = b.position - b.velocity * remaining;
+    glm::vec3 diff = separation(touchA, touchB);
+    float dist = glm::length(diff);
+    if (dist <= 0.0f) return;
+
+    glm::vec3 normal = diff / dist;
+    float approach = glm::dot(a.velocity - b.velocity, normal);
+    float totalMass = a.mass + b.mass;
+    if (approach < 0.0f && totalMass > 0.0f) {
+        a.velocity -= normal * (2.0f * approach * b.mass / totalMass);
+        b.velocity += normal * (2.0f * approach * a.mass / totalMass);
+    }
+    a.position = touchA + a.velocity * remaining;
+    b.position = touchB + b.velocity * remaining;
+    wrapBody(contact.first);
+    wrapBody(contact.second);
+}
+
+// Perfect merge: every connected cluster of colliding bodies becomes one body
+// at the cluster's centre of mass, carrying its total mass and momentum. The
+// lowest index survives, so a central body keeps its slot. Returns whether
+// any body was absorbed.
+bool PhysicsEngine::mergeCollidingBodies() {
+    if (closePairs.empty()) return false;
+    absorbed.assign(bodies.size(), 0);
+    mergeParent.resize(bodies.size());
+    for (const auto& pair : closePairs) {
+        mergeParent[pair.first] = pair.first;
+        mergeParent[pair.second] = pair.second;
+    }
+    auto find = [&](std::uint32_t i) {
+        while (mergeParent[i] != i) {
+            mergeParent[i] = mergeParent[mergeParent[i]];
+            i = mergeParent[i];
+        }
+        return i;
+    };
+    for (const auto& pair : closePairs) {
+        std::uint32_t a = find(pair.first);
+        std::uint32_t b = find(pair.second);
+        if (a != b) {
+            mergeParent[std::max(a, b)] = std::min(a, b);
+        }
+    }
+
+    // Pairs are sorted, so each body is folded into its root in index order
+    for (const auto& pair : closePairs) {
+        for (std::uint32_t i : {pair.first, pair.second}) {
+            std::uint32_t root = find(i);
+            if (root == i || absorbed[i]) continue;
+            Body& target = bodies[root];
+            const Body& source = bodies[i];
+            float mass = target.mass + source.mass;
+            if (mass > 0.0f) {
+                glm::vec3 offset = separation(source.position, target.position);
+                target.position += offset * (source.mass / mass);
+                target.velocity = (target.velocity * target.mass + source.velocity * source.mass) / mass;
+            }
+            target.mass = mass;
+            // Merged bodies keep their combined volume
+            target.radius = std::cbrt(target.radius * target.radius * target.radius
+                                      + source.radius * source.radius * source.radius);
+            wrapBody(root);
+            absorbed[i] = 1;
+            collisionPending[i] = 0;
+        }
+    }
+    return true;
+}
+
+// Stable in-place removal of absorbed bodies; survivors keep their order
+void PhysicsEngine::compactBodies() {
+    const size_t count = bodies.size();
+    const bool keepGravityCosts = gravityCosts.size() == count;
+    const bool keepCollisionCosts = collisionCosts.size() == count;
+    size_t write = 0;
+    for (size_t read = 0; read < count; ++read) {
+        if (absorbed[read]) continue;
+        if (write != read) {
+            bodies[write] = bodies[read];
+            if (keepGravityCosts) gravityCosts[write] = gravityCosts[read];
+            if (keepCollisionCosts) collisionCosts[write] = collisionCosts[read];
+        }
+        ++write;
+    }
+    bodies.resize(write);
+    bodySlots.eraseFlagged(absorbed);
+    neighbourAnchors.clear();   // indices have shifted
+    collisionPending.resize(write);
+    if (keepGravityCosts) gravityCosts.resize(write);
+    if (keepCollisionCosts) collisionCosts.resize(write);
+}
+
+// Detect overlapping pairs in parallel; they are resolved serially afterwards
+void PhysicsEngine::findCollisionPairs(float minDist) {
+    TaskScheduler& scheduler = TaskScheduler::instance();
+    workerPairs.resize(scheduler.getSlotCount());
+    for (auto& pairs : workerPairs) {
+        pairs.clear();
+    }
+    const float minDist2 = minDist * minDist;
+    const float skin = config.neighbourSkin;
+    if (skin > 0.0f) {
+        // Only the neighbour lists are tested; they hold every pair that can
+        // have come within minDist since they were built
+        if (neighbourListsStale(minDist + skin, skin)) {
+            buildNeighbourLists(minDist + skin);
+        }
+        scheduler.parallelForRanges(balancedRanges(collisionCosts), [&](size_t begin, size_t end) {
+            auto& pairs = workerPairs[scheduler.currentWorker()];
+            for (size_t i = begin; i < end; ++i) {
+                for (std::uint32_t k = neighbourStart[i]; k < neighbourStart[i + 1]; ++k) {
+                    const std::uint32_t j = neighbourList[k];
+                    glm::vec3 diff = separation(bodies[i].position, bodies[j].position);
+                    if (glm::dot(diff, diff) < minDist2) {
+                        pairs.emplace_back(static_cast<std::uint32_t>(i), j);
+                    }
+                }
+                collisionCosts[i] = neighbourStart[i + 1] - neighbourStart[i];
+            }
+        });
+    } else {
+        // Row i tests N - i - 1 pairs, so equal body counts would be badly skewed
+        scheduler.parallelForRanges(balancedRanges(collisionCosts), [&](size_t begin, size_t end) {
+            auto& pairs = workerPairs[scheduler.currentWorker()];
+            for (size_t i = begin; i < end; ++i) {
+                for (size_t j = i + 1; j < bodies.size(); ++j) {
+                    glm::vec3 diff = separation(bodies[i].position, bodies[j].position);
+                    if (glm::dot(diff, diff) < minDist2) {
+                        pairs.emplace_back(static_cast<std::uint32_t>(i), static_cast<std::uint32_t>(j));
+                    }
+                }
+                collisionCosts[i] = static_cast<std::uint32_t>(bodies.size() - i - 1);
+            }
+        });
+    }
+    closePairs.clear();
+    for (const auto& pairs : workerPairs) {
+        closePairs.insert(closePairs.end(), pairs.begin(), pairs.end());
+    }
+    std::sort(closePairs.begin(), closePairs.end());
+}
+
+// The lists stay valid until two bodies may have closed the skin between
+// them, i.e. until any body has moved more than half of it
+bool PhysicsEngine::neighbourListsStale(float cutoff, float skin) {
+    if (neighbourAnchors.size() != bodies.size() || cutoff != neighbourCutoff) {
+        return true;
+    }
+    const float limit2 = 0.25f * skin * skin;
+    std::atomic<bool> moved{false};
+    TaskScheduler::instance().parallelFor(bodies.size(), 16384, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end && !moved.load(std::memory_order_relaxed); ++i) {
+            glm::vec3 diff = separation(bodies[i].position, neighbourAnchors[i]);
+            if (glm::dot(diff, diff) > limit2) {
+                moved.store(true, std::memory_order_relaxed);
+            }
+        }
+    });
+    return moved.load();
+}
+
+// Sort along x and sweep: only bodies within cutoff in x can be neighbours
+void PhysicsEngine::buildNeighbourLists(float cutoff) {
+    TaskScheduler& scheduler = TaskScheduler::instance();
+    const size_t count = bodies.size();
+    const float cutoff2 = cutoff * cutoff;
+    neighbourCutoff = cutoff;
+    neighbourAnchors.resize(count);
+    sweepOrder.resize(count);
+    scheduler.parallelFor(count, 16384, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            neighbourAnchors[i] = bodies[i].position;
+            sweepOrder[i] = static_cast<std::uint32_t>(i);
+        }
+    });
+    std::sort(sweepOrder.begin(), sweepOrder.end(), [&](std::uint32_t a, std::uint32_t b) {
+        return neighbourAnchors[a].x < neighbourAnchors[b].x;
+    });
+
+    // In a periodic box the sweep continues past the end of the order into
+    // the next image of the box, up to but excluding the body itself
+    const float box = config.periodicBoxSize;
+    scheduler.parallelFor(count, 1024, [&](size_t begin, size_t end) {
+        auto& pairs = workerPairs[scheduler.currentWorker()];
+        for (size_t k = begin; k < end; ++k) {
+            const std::uint32_t a = sweepOrder[k];
+            const glm::vec3 p = neighbourAnchors[a];
+            const size_t sweepEnd = box > 0.0f ? count + k : count;
+            for (size_t m = k + 1; m < sweepEnd; ++m) {
+                const std::uint32_t b = sweepOrder[m < count ? m : m - count];
+                const float gap = neighbourAnchors[b].x + (m < count ? 0.0f : box) - p.x;
+                if (gap > cutoff) break;
+                glm::vec3 diff = separation(p, neighbourAnchors[b]);
+                if (glm::dot(diff, diff) <= cutoff2) {
+                    pairs.emplace_back(std::min(a, b), std::max(a, b));
                 }
-                
-                // Add significant random velocity to break out of stuck states
-                if (dist < minDist * 0.7f) {
-                    bodies[i].velocity += glm::vec3(0.4f, 0.0f, 0.4f) * (float)(rand() % 100) / 100.0f;
-                    bodies[j].velocity += glm::vec3(0.4f, 0.0f, 0.4f) * (float)(rand() % 100) / 100.0f;
+            }
+        }
+    });
+
+    if (box > 0.0f && box < 2.0f * cutoff) {
+        // A box this narrow lets the sweep reach a pair both directly and
+        // through the wrap; keep one of each
+        std::vector<std::pair<std::uint32_t, std::uint32_t>>& all = workerPairs[0];
+        for (size_t w = 1; w < workerPairs.size(); ++w) {
+            all.insert(all.end(), workerPairs[w].begin(), workerPairs[w].end());
+            workerPairs[w].clear();
+        }
+        std::sort(all.begin(), all.end());
+        all.erase(std::unique(all.begin(), all.end()), all.end());
+    }
+
+    // Bucket the pairs by their lower index
+    neighbourStart.assign(count + 1, 0);
+    for (const auto& pairs : workerPairs) {
+        for (const auto& pair : pairs) {
+            ++neighbourStart[pair.first + 1];
+        }
+    }
+    for (size_t i = 0; i < count; ++i) {
+        neighbourStart[i + 1] += neighbourStart[i];
+    }
+    neighbourList.resize(neighbourStart[count]);
+    std::vector<std::uint32_t> cursor(neighbourStart.begin(), neighbourStart.end() - 1);
+    for (auto& pairs : workerPairs) {
+        for (const auto& pair : pairs) {
+            neighbourList[cursor[pair.first]++] = pair.second;
+        }
+        pairs.clear();
+    }
+    scheduler.parallelFor(count, 4096, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            std::sort(neighbourList.begin() + neighbourStart[i], neighbourList.begin() + neighbourStart[i + 1]);
+        }
+    });
+}
+
+void PhysicsEngine::computeDirectAccelerations(float gravityConstant) {
+    if (config.periodicBoxSize > 0.0f) {
+        computePeriodicDirectAccelerations(gravityConstant);
+        return;
+    }
+    TaskScheduler& scheduler = TaskScheduler::instance();
+    const size_t count = bodies.size();
+    accelerations.resize(count);
+
+    // Pack the sources once so every block of targets streams them contiguously
+    packedX.resize(count);
+    packedY.resize(count);
+    packedZ.resize(count);
+    packedM.resize(count);
+    scheduler.parallelFor(count, 16384, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            packedX[i] = bodies[i].position.x;
+            packedY[i] = bodies[i].position.y;
+            packedZ[i] = bodies[i].position.z;
+            packedM[i] = bodies[i].mass;
+        }
+    });
+
+    scheduler.parallelForRanges(balancedRanges(gravityCosts), [&](size_t begin, size_t end) {
+        const size_t blockSize = 64;
+        float ax[blockSize], ay[blockSize], az[blockSize];
+        for (size_t block = begin; block < end; block += blockSize) {
+            const size_t n = std::min(blockSize, end - block);
+            std::fill(ax, ax + n, 0.0f);
+            std::fill(ay, ay + n, 0.0f);
+            std::fill(az, az + n, 0.0f);
+            // A body's own term has zero separation and adds nothing
+            forceLaw.accumulate(packedX.data(), packedY.data(), packedZ.data(), packedM.data(), count,
+                                packedX.data() + block, packedY.data() + block, packedZ.data() + block,
+                                ax, ay, az, n);
+            for (size_t k = 0; k < n; ++k) {
+                accelerations[block + k] = glm::vec3(ax[k], ay[k], az[k]) * gravityConstant;
+                gravityCosts[block + k] = static_cast<std::uint32_t>(count - 1);
+            }
+        }
+    });
+}
+
+// Direct sum in a periodic box. A table lookup per pair costs some forty
+// times the pair itself, so the Ewald correction is taken per cell instead:
+// the bodies are binned into an odd number of cells per axis, and for every
+// target cell each source cell is seen at its image nearest the cell. With
+// an odd count the half-box planes of a cell centre fall on cell
+// boundaries, so every source cell has one such image as a whole. The pairs
+// are summed exactly through those images; the correction, which varies on
+// the scale of the box, is summed over the source cells' centres of mass at
+// the target cell's centre and extrapolated to each body along its gradient,
+// as the tree does for its compact groups. That costs the direct sum its
+// exactness: the error is a few tenths of a percent, shrinking with the
+// square of the cell size, and highest where opposite forces nearly cancel.
+void PhysicsEngine::computePeriodicDirectAccelerations(float gravityConstant) {
+    TaskScheduler& scheduler = TaskScheduler::instance();
+    const EwaldTable& ewald = EwaldTable::instance();
+    const size_t count = bodies.size();
+    const float box = config.periodicBoxSize;
+    accelerations.resize(count);
+    gravityCosts.assign(count, static_cast<std::uint32_t>(count - 1));
+
+    // About periodicCellBodies bodies per cell, within the range where the
+    // extrapolation holds and the correction sums stay cheap
+    int side = 5;
+    while (side < 25 && static_cast<size_t>(side + 2) * (side + 2) * (side + 2) * periodicCellBodies <= count) {
+        side += 2;
+    }
+    const int cellCount = side * side * side;
+    const float cellSize = box / side;
+    auto cellOf = [&](const glm::vec3& p) {
+        auto axis = [&](float x) { return std::min(std::max(static_cast<int>((x + 0.5f * box) / cellSize), 0), side - 1); };
+        return (axis(p.x) * side + axis(p.y)) * side + axis(p.z);
+    };
+
+    // Counting sort into cells, packing wrapped positions in cell order
+    cellStart.assign(cellCount + 1, 0);
+    cellOrder.resize(count);
+    packedX.resize(count);
+    packedY.resize(count);
+    packedZ.resize(count);
+    packedM.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        ++cellStart[cellOf(Periodic::wrap(bodies[i].position, box)) + 1];
+    }
+    for (int c = 0; c < cellCount; ++c) {
+        cellStart[c + 1] += cellStart[c];
+    }
+    std::vector<std::uint32_t> cursor(cellStart.begin(), cellStart.end() - 1);
+    for (size_t i = 0; i < count; ++i) {
+        const glm::vec3 p = Periodic::wrap(bodies[i].position, box);
+        const std::uint32_t k = cursor[cellOf(p)]++;
+        cellOrder[k] = static_cast<std::uint32_t>(i);
+        packedX[k] = p.x;
+        packedY[k] = p.y;
+        packedZ[k] = p.z;
+        packedM[k] = bodies[i].mass;
+    }
+    cellMass.assign(cellCount, 0.0f);
+    cellCenterOfMass.assign(cellCount, glm::vec3(0.0f));
+    for (int c = 0; c < cellCount; ++c) {
+        glm::vec3 weighted(0.0f);
+        for (std::uint32_t k = cellStart[c]; k < cellStart[c + 1]; ++k) {
+            weighted += glm::vec3(packedX[k], packedY[k], packedZ[k]) * packedM[k];
+            cellMass[c] += packedM[k];
+        }
+        cellCenterOfMass[c] = cellMass[c] > 0.0f ? weighted / cellMass[c] : glm::vec3(0.0f);
+    }
+
+    auto computeCells = [&](size_t begin, size_t end) {
+        const size_t blockSize = 64;
+        float ax[blockSize], ay[blockSize], az[blockSize];
+        float tx[blockSize], ty[blockSize], tz[blockSize];
+        std::vector<glm::vec3> shift(cellCount);
+        std::vector<float> mx, my, mz, mm;
+        for (size_t target = begin; target < end; ++target) {
+            if (cellStart[target] == cellStart[target + 1]) continue;
+            const int ti = static_cast<int>(target) / (side * side);
+            const int tj = static_cast<int>(target) / side % side;
+            const int tk = static_cast<int>(target) % side;
+            const glm::vec3 center = (glm::vec3(ti, tj, tk) + glm::vec3(0.5f)) * cellSize - glm::vec3(0.5f * box);
+
+            // Every source cell at its image nearest this one, moved by a
+            // whole number of boxes
+            mx.clear(); my.clear(); mz.clear(); mm.clear();
+            auto image = [&](int s, int t) {
+                const int d = s - t;
+                return d > side / 2 ? -box : (d < -(side / 2) ? box : 0.0f);
+            };
+            for (int source = 0; source < cellCount; ++source) {
+                shift[source] = glm::vec3(image(source / (side * side), ti), image(source / side % side, tj),
+                                          image(source % side, tk));
+                if (cellMass[source] > 0.0f) {
+                    const glm::vec3 c = cellCenterOfMass[source] + shift[source];
+                    mx.push_back(c.x);
+                    my.push_back(c.y);
+                    mz.push_back(c.z);
+                    mm.push_back(cellMass[source]);
+                }
+            }
+            auto correctionAt = [&](const glm::vec3& p) {
+                return ewald.accumulate(mx.data(), my.data(), mz.data(), mm.data(), mm.size(), p, box);
+            };
+            // Two table cells: wide enough to step over the trilinear kinks
+            const float h = 2.0f * EwaldTable::extent * box / EwaldTable::resolution;
+            const glm::vec3 correction = correctionAt(center);
+            glm::vec3 slope[3];
+            for (int axis = 0; axis < 3; ++axis) {
+                glm::vec3 step(0.0f);
+                step[axis] = h;
+                slope[axis] = (correctionAt(center + step) - correctionAt(center - step)) / (2.0f * h);
+            }
+
+            for (size_t block = cellStart[target]; block < cellStart[target + 1]; block += blockSize) {
+                const size_t n = std::min<size_t>(blockSize, cellStart[target + 1] - block);
+                std::fill(ax, ax + n, 0.0f);
+                std::fill(ay, ay + n, 0.0f);
+                std::fill(az, az + n, 0.0f);
+                // Moving the targets against the source image keeps the
+                // sources in place; a body's own term still has zero separation
+                for (int source = 0; source < cellCount; ++source) {
+                    const std::uint32_t first = cellStart[source], last = cellStart[source + 1];
+                    if (first == last) continue;
+                    for (size_t k = 0; k < n; ++k) {
+                        tx[k] = packedX[block + k] - shift[source].x;
+                        ty[k] = packedY[block + k] - shift[source].y;
+                        tz[k] = packedZ[block + k] - shift[source].z;
+                    }
+                    forceLaw.accumulate(packedX.data() + first, packedY.data() + first, packedZ.data() + first,
+                                        packedM.data() + first, last - first, tx, ty, tz, ax, ay, az, n);
+                }
+                for (size_t k = 0; k < n; ++k) {
+                    const glm::vec3 offset = glm::vec3(packedX[block + k], packedY[block + k], packedZ[block + k]) - center;
+                    const glm::vec3 c = correction + slope[0] * offset.x + slope[1] * offset.y + slope[2] * offset.z;
+                    accelerations[cellOrder[block + k]] = (glm::vec3(ax[k], ay[k], az[k]) + c) * gravityConstant;
                 }
             }
         }
+    };
+    if (serialPasses) {
+        computeCells(0, cellCount);
+    } else {
+        scheduler.parallelFor(cellCount, 1, computeCells);
     }
-    
-    for (auto& b : bodies) {
-        b.position += b.velocity*dt;
-        // Ensure all bodies stay on the XZ plane
-        b.position.y = 0.0f;
+}
+
+void PhysicsEngine::computeTreeAccelerations(float gravityConstant) {
+    tree.setPeriodicBox(config.periodicBoxSize);
+    tree.build(bodies);
+    tree.computeAccelerations(gravityConstant, forceLaw, accelerations, gravityCosts);
+}
+
+// Equal-cost ranges for this pass, predicted from the counts recorded last step
+std::vector<size_t> PhysicsEngine::balancedRanges(std::vector<std::uint32_t>& costs) {
+    if (costs.size() != bodies.size()) {
+        costs.assign(bodies.size(), 1);
     }
+    if (serialPasses) {
+        return {0, bodies.size()};
+    }
+    return TaskScheduler::partitionByCost(costs, TaskScheduler::instance().getThreadCount());
 }
+
+void PhysicsEngine::setConfig(const PhysicsConfig& newConfig) {
+    config = newConfig;
+    externalField = ExternalField::fromConfig(config.externalFields);
+    customExternalField = false;
+    prepareEwaldTable();
+}
+
+// The periodic solvers look the table up from inside their parallel passes,
+// where building it would deadlock (see EwaldTable::instance), so it is
+// built as soon as a periodic box is configured
+void PhysicsEngine::prepareEwaldTable() const {
+    if (config.periodicBoxSize > 0.0f) {
+        EwaldTable::instance();
+    }
+}
+
+const PhysicsConfig& PhysicsEngine::getConfig() const {
+    return config;
+}
+
+void PhysicsEngine::setForceLaw(ForceLaw law) {
+    forceLaw = std::move(law);
+}
+
+const ForceLaw& PhysicsEngine::getForceLaw() const {
+    return forceLaw;
+}
+
+void PhysicsEngine::setExternalField(ExternalField field) {
+    externalField = std::move(field);
+    customExternalField = true;
+}
+
+bool PhysicsEngine::hasCustomExternalField() const {
+    return customExternalField;
+}
+
+void PhysicsEngine::setForceSolver(ForceSolver solver) {
+    forceSolver = solver;
+}
+
+PhysicsEngine::ForceSolver PhysicsEngine::getForceSolver() const {
+    return forceSolver;
+}
+
+void PhysicsEngine::setTreeParameters(float theta, std::size_t groupSize) {
+    tree.setOpeningAngle(theta);
+    tree.setGroupSize(groupSize);
+}
+
+void PhysicsEngine::setDualTreeOpeningAngle(float theta) {
+    tree.setDualOpeningAngle(theta);
+}
+
+float PhysicsEngine::getOpeningAngle() const {
+    return tree.getOpeningAngle();
+}
+
+float PhysicsEngine::getDualTreeOpeningAngle() const {
+    return tree.getDualOpeningAngle();
+}
+
+std::size_t PhysicsEngine::getGroupSize() const {
+    return tree.getGroupSize();
+}
+
 const std::vector<PhysicsEngine::Body>& PhysicsEngine::getBodies() const {
     return bodies;
+}
+
+const std::vector<PhysicsEngine::BodyHandle>& PhysicsEngine::getBodyHandles() const {
+    return bodySlots.handles();
+}
+
+PhysicsEngine::StateView PhysicsEngine::view() const {
+    const size_t count = bodies.size();
+    const Body* first = bodies.data();
+    return {
+        epoch,
+        {first ? &first->position : nullptr, count, sizeof(Body)},
+        {first ? &first->velocity : nullptr, count, sizeof(Body)},
+        {first ? &first->mass : nullptr, count, sizeof(Body)},
+        {first ? &first->radius : nullptr, count, sizeof(Body)},
+        {bodySlots.handles().data(), count},
+    };
+}
+
+std::uint64_t PhysicsEngine::getEpoch() const {
+    return epoch;
+}
+
+const std::vector<std::uint32_t>& PhysicsEngine::getInteractionCounts() const {
+    return gravityCosts;
+}
+
+std::uint64_t PhysicsEngine::getStepCount() const {
+    return stepCount;
+}
+
+double PhysicsEngine::getTime() const {
+    return time;
+}
+
+void PhysicsEngine::seedRandom(std::uint64_t seed) {
+    random.state = seed;
+}
+
+const SplitMix64& PhysicsEngine::getRandom() const {
+    return random;
 }
\ No newline at end of file
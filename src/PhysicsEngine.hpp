@@ -1,5 +1,14 @@
 #pragma once
+#include "CollisionKernels.hpp"
+#include "ConfigLoader.hpp"
+#include "ExternalFields.hpp"
+#include "Octree.hpp"
+#include "Random.hpp"
+#include "SlotMap.hpp"
+#include "StridedSpan.hpp"
 #include <glm/glm.hpp>
+#include <cstdint>
+#include <utility>
 #include <vector>
 
 class PhysicsEngine {
@@ -8,12 +17,183 @@ class PhysicsEngine {
             glm::vec3 position;
             glm::vec3 velocity;
             float mass;
+            float radius = 0.0f;   // grows by volume when bodies merge
         };
-        void addBody(const Body& b);
+
+        // How pairwise gravity is evaluated each step
+        enum class ForceSolver {
+            DirectSum,  // exact O(N^2) double loop; in a periodic box the Ewald
+                        // correction is taken per cell, to about 0.5%
+            Tree,       // Barnes-Hut group walk, O(N log N)
+            DualTree    // dual-tree walk that also finds collision pairs; less accurate
+                        // per opening angle, so it has its own (setDualTreeOpeningAngle)
+        };
+
+        // Stays valid until the body is removed or merged into another one
+        using BodyHandle = SlotHandle;
+
+        // Initial conditions as separate arrays, one entry per body.
+        // radius may be null, leaving every radius at 0.
+        struct BodyColumns {
+            const float* x;
+            const float* y;
+            const float* z;
+            const float* vx;
+            const float* vy;
+            const float* vz;
+            const float* mass;
+            const float* radius = nullptr;
+        };
+
+        // Read-only columns over the live body array, without copies. They
+        // stay valid, and describe the state numbered epoch, until the engine
+        // is next modified (update, add, remove or mutable getBody).
+        struct StateView {
+            std::uint64_t epoch;
+            StridedSpan<const glm::vec3> positions;
+            StridedSpan<const glm::vec3> velocities;
+            StridedSpan<const float> masses;
+            StridedSpan<const float> radii;
+            StridedSpan<const BodyHandle> handles;
+
+            size_t size() const { return positions.size(); }
+        };
+
+        PhysicsEngine() = default;
+        explicit PhysicsEngine(const PhysicsConfig& config);
+
+        BodyHandle addBody(const Body& b);
+        // Appends count bodies in one go, copied in parallel. Returns the index
+        // of the first one in getBodies(); their handles follow in getBodyHandles().
+        size_t addBodies(const Body* source, size_t count);
+        size_t addBodies(const BodyColumns& columns, size_t count);
+        // Makes room up front so that adding bodies never reallocates
+        void reserveBodies(size_t count);
+        // O(1): the last body takes the removed body's place in getBodies()
+        bool removeBody(BodyHandle handle);
+        // nullptr once the body has been removed or merged away
+        Body* getBody(BodyHandle handle);
+        const Body* getBody(BodyHandle handle) const;
         void update(float dt);
+        // steps updates of dt in one batch, e.g. for time warp. Per-step
+        // bookkeeping is done once, and small scenes run on the calling
+        // thread throughout instead of waking the workers every step.
+        void advance(float dt, unsigned steps);
         const std::vector<Body>& getBodies() const;
+        // Handle of each body in getBodies(), in the same order
+        const std::vector<BodyHandle>& getBodyHandles() const;
+        StateView view() const;
+        // Counts modifications of the body state; a view whose epoch differs
+        // from this is out of date
+        std::uint64_t getEpoch() const;
+        // Per-body gravity interactions evaluated in the last step
+        const std::vector<std::uint32_t>& getInteractionCounts() const;
+        // Steps taken and simulated seconds elapsed, carried over by checkpoints
+        std::uint64_t getStepCount() const;
+        double getTime() const;
+        // Seeds the generator behind the random kicks that free stuck bodies
+        void seedRandom(std::uint64_t seed);
+        const SplitMix64& getRandom() const;
+
+        void setConfig(const PhysicsConfig& config);
+        const PhysicsConfig& getConfig() const;
+
+        // Pair force law; any ForceLaws:: functor or user callable float(float r2)
+        void setForceLaw(ForceLaw law);
+        const ForceLaw& getForceLaw() const;
+        // Background potential applied to every body. setConfig() rebuilds it from
+        // config.externalFields; this accepts any field, e.g. an ExternalFields::Composite.
+        void setExternalField(ExternalField field);
+        // True while a field set with setExternalField() stands in for config.externalFields
+        bool hasCustomExternalField() const;
+
+        void setForceSolver(ForceSolver solver);
+        ForceSolver getForceSolver() const;
+        // theta is the Barnes-Hut opening angle of the group walk (Tree),
+        // groupSize the bodies sharing one interaction list
+        void setTreeParameters(float theta, std::size_t groupSize);
+        // Opening angle of the DualTree walk (default 0.2). Its error grows much
+        // faster with theta than the group walk's; see Octree::setDualOpeningAngle
+        void setDualTreeOpeningAngle(float theta);
+        float getOpeningAngle() const;
+        float getDualTreeOpeningAngle() const;
+        std::size_t getGroupSize() const;
     
     private:
+        friend class Checkpoint;
+
         std::vector<Body> bodies;
+        SlotMap bodySlots;                          // handles -> indices into bodies
+        std::uint64_t epoch = 0;
+        std::uint64_t stepCount = 0;
+        double time = 0.0;
+        SplitMix64 random;
+        // Scenes up to this size run every pass on the calling thread
+        static constexpr size_t serialBodyLimit = 128;
+        bool serialPasses = false;
+        PhysicsConfig config;
+        std::vector<glm::vec3> accelerations;
+        std::vector<std::pair<std::uint32_t, std::uint32_t>> closePairs;
+        std::vector<std::vector<std::pair<std::uint32_t, std::uint32_t>>> workerPairs;
+        std::vector<std::uint8_t> collisionPending;
+        std::vector<std::uint8_t> absorbed;         // merged into another body this step
+        std::vector<std::uint32_t> mergeParent;     // union-find over colliding bodies
+        // Per-body work recorded in the last step, used to split the next one
+        std::vector<std::uint32_t> gravityCosts;
+        std::vector<std::uint32_t> collisionCosts;
+        // Verlet neighbour lists for the overlap test: for every body, the
+        // higher-indexed bodies within minDistance + skin (CSR layout), and
+        // where every body was when they were built
+        std::vector<std::uint32_t> neighbourStart;
+        std::vector<std::uint32_t> neighbourList;
+        std::vector<glm::vec3> neighbourAnchors;
+        float neighbourCutoff = 0.0f;
+        // Continuous collision detection: swept bounds of every body over the
+        // step, their order along x, per-worker candidate pairs and the hits
+        struct SweptBox {
+            glm::vec3 min, max;
+        };
+        struct Contact {
+            std::uint32_t first, second;
+            float time;     // fraction of the step at first touch
+        };
+        std::vector<SweptBox> sweptBoxes;
+        std::vector<std::uint32_t> sweepOrder;
+        std::vector<SweptPairList> workerSweeps;
+        std::vector<Contact> contacts;
+        ForceSolver forceSolver = ForceSolver::DirectSum;
+        ForceLaw forceLaw;
+        ExternalField externalField;
+        bool customExternalField = false;
+        std::vector<float> packedX, packedY, packedZ, packedM;
+        // Periodic direct sum: bodies binned into cells (CSR layout, packed
+        // in cell order) and every cell's mass and centre of mass
+        static constexpr size_t periodicCellBodies = 64;
+        std::vector<std::uint32_t> cellStart;
+        std::vector<std::uint32_t> cellOrder;
+        std::vector<float> cellMass;
+        std::vector<glm::vec3> cellCenterOfMass;
+        Octree tree;
         static constexpr double G = 6.67430e-11;
+
+        void step(float dt);
+        void computeDirectAccelerations(float gravityConstant);
+        void computePeriodicDirectAccelerations(float gravityConstant);
+        void computeTreeAccelerations(float gravityConstant);
+        void prepareEwaldTable() const;
+        // Fused per-body sweep with the disabled features compiled out
+        template <bool UseDamping, bool UseClamp, bool UseBoundary, bool UsePeriodic>
+        void integrate(float dt);
+        // i's position relative to j, through the periodic box when there is one
+        glm::vec3 separation(const glm::vec3& pi, const glm::vec3& pj) const;
+        void wrapBody(size_t i);
+        std::vector<size_t> balancedRanges(std::vector<std::uint32_t>& costs);
+        void findCollisionPairs(float minDist);
+        bool neighbourListsStale(float cutoff, float skin);
+        void buildNeighbourLists(float cutoff);
+        void resolveCollision(size_t i, size_t j, float minDist);
+        void findSweptCollisions(float dt);
+        void resolveContact(const Contact& contact, float dt);
+        bool mergeCollidingBodies();
+        void compactBodies();
 };
\ No newline at end of file
@@ -0,0 +1,16 @@
+#pragma once
+#include <cstdint>
+
+// SplitMix64 generator (Steele, Lea & Flood). Its whole state is one
+// integer, so an engine can save it in a checkpoint and every lane of a
+// LaneBatch can carry its own copy.
+struct SplitMix64 {
+    std::uint64_t state = 0x853c49e6748fea9bull;
+
+    std::uint64_t next() {
+        std::uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+};
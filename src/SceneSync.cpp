@@ -0,0 +1,124 @@
+#include "SceneSync.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    bool sameField(const ExternalFieldConfig& a, const ExternalFieldConfig& b) {
+        return a.type == b.type && a.center == b.center && a.acceleration == b.acceleration
+            && a.mass == b.mass && a.scaleRadius == b.scaleRadius && a.stiffness == b.stiffness;
+    }
+
+    bool samePhysics(const PhysicsConfig& a, const PhysicsConfig& b) {
+        return a.gravityConstant == b.gravityConstant && a.damping == b.damping
+            && a.maxVelocity == b.maxVelocity && a.minDistance == b.minDistance
+            && a.boundaryRadius == b.boundaryRadius && a.orbitalCorrection == b.orbitalCorrection
+            && a.collisionMode == b.collisionMode && a.continuousCollisions == b.continuousCollisions
+            && a.neighbourSkin == b.neighbourSkin && a.periodicBoxSize == b.periodicBoxSize
+            && a.externalFields.size() == b.externalFields.size()
+            && std::equal(a.externalFields.begin(), a.externalFields.end(), b.externalFields.begin(), sameField);
+    }
+}
+
+void SceneSync::apply(const SimulationConfig& config, PhysicsEngine& engine) {
+    ConfigEdits everything;
+    everything.allObjects = true;
+    apply(config, engine, everything);
+}
+
+void SceneSync::apply(const SimulationConfig& config, PhysicsEngine& engine, const ConfigEdits& edits) {
+    apply(makePatch(config, edits, applied.size()), engine);
+}
+
+SceneSync::Patch SceneSync::makePatch(const SimulationConfig& config, const ConfigEdits& edits, size_t appliedCount) {
+    Patch patch;
+    patch.physics = config.physics;
+    patch.objectCount = config.objects.size();
+    patch.centralMass = config.objects.empty() ? 0.0f : config.objects[0].mass;
+    const size_t kept = std::min(appliedCount, config.objects.size());
+    if (edits.allObjects) {
+        for (size_t i = 0; i < kept; ++i) {
+            patch.indices.push_back(i);
+        }
+    } else {
+        for (size_t i : edits.objects) {
+            if (i < kept) patch.indices.push_back(i);
+        }
+    }
+    for (size_t i = kept; i < config.objects.size(); ++i) {
+        patch.indices.push_back(i);
+    }
+    patch.objects.reserve(patch.indices.size());
+    for (size_t i : patch.indices) {
+        patch.objects.push_back(summarize(config.objects[i]));
+    }
+    return patch;
+}
+
+void SceneSync::apply(const Patch& patch, PhysicsEngine& engine) {
+    if (!physicsApplied || !samePhysics(patch.physics, appliedPhysics)) {
+        engine.setConfig(patch.physics);
+        appliedPhysics = patch.physics;
+        physicsApplied = true;
+    }
+
+    // Objects removed from the end of the list
+    while (applied.size() > patch.objectCount) {
+        engine.removeBody(handles.back());
+        handles.pop_back();
+        applied.pop_back();
+    }
+
+    // Objects appended to the list come last and are added in one batch
+    const size_t known = applied.size();
+    std::vector<PhysicsEngine::Body> added;
+    for (size_t k = 0; k < patch.indices.size(); ++k) {
+        const size_t i = patch.indices[k];
+        const ObjectState& next = patch.objects[k];
+        if (i < known) {
+            patchObject(i, next, patch, engine);
+        } else if (i == applied.size()) {
+            applied.push_back(next);
+            added.push_back({next.position, launchVelocity(next, patch), next.mass, next.radius});
+        }
+    }
+    if (!added.empty()) {
+        const size_t index = engine.addBodies(added.data(), added.size());
+        const auto& engineHandles = engine.getBodyHandles();
+        handles.insert(handles.end(), engineHandles.begin() + index, engineHandles.end());
+    }
+}
+
+// Moving an object relaunches it from its new position; mass and radius
+// edits leave its motion alone
+void SceneSync::patchObject(size_t index, const ObjectState& next, const Patch& patch, PhysicsEngine& engine) {
+    ObjectState& last = applied[index];
+    const bool relaunch = next.position != last.position || next.velocity != last.velocity
+                          || next.orbiting != last.orbiting;
+    if (!relaunch && next.mass == last.mass && next.radius == last.radius) return;
+    last = next;
+
+    PhysicsEngine::Body* body = engine.getBody(handles[index]);
+    if (!body) {
+        // Merged away earlier; the edited object comes back as a new body
+        handles[index] = engine.addBody({next.position, launchVelocity(next, patch), next.mass, next.radius});
+        return;
+    }
+    body->mass = next.mass;
+    body->radius = next.radius;
+    if (relaunch) {
+        body->position = next.position;
+        body->velocity = launchVelocity(next, patch);
+    }
+}
+
+SceneSync::ObjectState SceneSync::summarize(const ObjectConfig& object) {
+    return {object.position, object.velocity, object.mass, object.radius, object.type == "orbiting"};
+}
+
+glm::vec3 SceneSync::launchVelocity(const ObjectState& object, const Patch& patch) {
+    if (!object.orbiting || patch.objectCount == 0) return object.velocity;
+    float orbitalRadius = glm::length(object.position);
+    if (orbitalRadius <= 0.0f) return object.velocity;
+    float orbitalVelocity = std::sqrt(patch.physics.gravityConstant * patch.centralMass / orbitalRadius) * 0.9f;
+    return glm::vec3(0.0f, 0.0f, orbitalVelocity);
+}
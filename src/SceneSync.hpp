@@ -0,0 +1,60 @@
+#pragma once
+#include "ConfigLoader.hpp"
+#include "PhysicsEngine.hpp"
+#include <cstddef>
+#include <vector>
+
+// Keeps a live PhysicsEngine in step with a SimulationConfig that is being
+// edited. apply() compares the config with the one it applied last and
+// patches only the differences into the engine: changed physics settings,
+// masses and radii, moved objects, and objects added or removed at the end.
+// All other bodies keep their state, so their orbits continue unbroken.
+//
+// When the engine lives on another thread, the editing thread hands over a
+// Patch instead of the config: the physics settings and only the objects
+// the edit touched, so the hand-over also costs the size of the edit.
+class SceneSync {
+public:
+    // The object fields the engine sees
+    struct ObjectState {
+        glm::vec3 position;
+        glm::vec3 velocity;
+        float mass;
+        float radius;
+        bool orbiting;
+    };
+
+    struct Patch {
+        PhysicsConfig physics;
+        size_t objectCount = 0;
+        float centralMass = 0.0f;           // mass of object 0, which orbiting objects circle
+        std::vector<size_t> indices;        // edited objects, then those appended in order
+        std::vector<ObjectState> objects;   // their new state, one per index
+    };
+
+    // Compares every object; the first call adds them all to the engine
+    void apply(const SimulationConfig& config, PhysicsEngine& engine);
+    // Compares only the edited objects, so the cost follows the size of the
+    // edit rather than of the scene
+    void apply(const SimulationConfig& config, PhysicsEngine& engine, const ConfigEdits& edits);
+    void apply(const Patch& patch, PhysicsEngine& engine);
+
+    // The edited objects plus the ones past appliedCount, the object count
+    // of the config this sync applied last
+    static Patch makePatch(const SimulationConfig& config, const ConfigEdits& edits, size_t appliedCount);
+
+    // Body of each config object, by object index. A handle stops resolving
+    // once its body has been merged into another one.
+    const std::vector<PhysicsEngine::BodyHandle>& getHandles() const { return handles; }
+
+private:
+    std::vector<ObjectState> applied;   // as last applied
+    std::vector<PhysicsEngine::BodyHandle> handles;
+    PhysicsConfig appliedPhysics;
+    bool physicsApplied = false;
+
+    void patchObject(size_t index, const ObjectState& next, const Patch& patch, PhysicsEngine& engine);
+    static ObjectState summarize(const ObjectConfig& object);
+    // Launch velocity: circular about the first object for "orbiting" ones
+    static glm::vec3 launchVelocity(const ObjectState& object, const Patch& patch);
+};
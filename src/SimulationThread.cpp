@@ -0,0 +1,206 @@
+#include "SimulationThread.hpp"
+#include "Ewald.hpp"
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <memory>
+
+std::uint32_t SimulationThread::Snapshot::find(BodyHandle handle) const {
+    if (handle.slot >= slotIndex.size()) return SlotMap::npos;
+    std::uint32_t index = slotIndex[handle.slot];
+    return index != SlotMap::npos && handles[index] == handle ? index : SlotMap::npos;
+}
+
+float SimulationThread::Snapshot::blendAt(Clock::time_point now) const {
+    if (wallStep <= 0.0f) return 1.0f;
+    float blend = std::chrono::duration<float>(now - wallTime).count() / wallStep;
+    return std::min(std::max(blend, 0.0f), 1.0f);
+}
+
+SimulationThread::SimulationThread(const PhysicsConfig& config, float dt)
+    : engine(config), dt(dt) {
+}
+
+SimulationThread::~SimulationThread() {
+    stop();
+}
+
+void SimulationThread::start() {
+    if (running.exchange(true)) return;
+    thread = std::thread(&SimulationThread::run, this);
+}
+
+void SimulationThread::stop() {
+    running = false;
+    if (thread.joinable()) thread.join();
+}
+
+void SimulationThread::post(Command command) {
+    std::lock_guard<std::mutex> lock(commandMutex);
+    commands.push_back(std::move(command));
+}
+
+void SimulationThread::record(SnapshotWriter* writer, std::uint64_t every) {
+    auto apply = [this, writer, every]() {
+        recorder = writer;
+        recordEvery = std::max<std::uint64_t>(every, 1);
+        nextRecord = steps;
+    };
+    if (!running.load()) {
+        // No thread to race with; start() and stop() come from this thread too
+        apply();
+        return;
+    }
+    // Wait until the simulation thread has switched writers, so the old one
+    // receives no further submit() once this returns
+    auto done = std::make_shared<std::promise<void>>();
+    std::future<void> switched = done->get_future();
+    post([apply, done](PhysicsEngine&) {
+        apply();
+        done->set_value();
+    });
+    switched.wait();
+}
+
+void SimulationThread::track(const std::vector<BodyHandle>& handles) {
+    tracked = handles;
+    ++trackedVersion;
+}
+
+const SimulationThread::Snapshot& SimulationThread::latest() {
+    snapshots.update();
+    return snapshots.readBuffer();
+}
+
+void SimulationThread::run() {
+    double owed = 0.0;      // simulated seconds due but not yet stepped
+    auto last = Clock::now();
+    auto rateStart = last;
+    double rateStartTime = 0.0;
+
+    runCommands();
+    recordBefore();
+    publish(last, 0.0f);
+    while (running.load(std::memory_order_relaxed)) {
+        const double warp = timeWarp.load(std::memory_order_relaxed);
+        std::this_thread::sleep_until(last + std::chrono::duration_cast<Clock::duration>(
+                                                 std::chrono::duration<double>((dt - owed) / warp)));
+        const auto now = Clock::now();
+        owed += std::chrono::duration<double>(now - last).count() * warp;
+        last = now;
+
+        // Time warp scales the steps owed per wake-up, so the cap scales too
+        const double cap = maxCatchUpSteps.load(std::memory_order_relaxed) * std::max(warp, 1.0);
+        if (owed > cap * dt) {
+            // Too far behind: drop the backlog rather than spiral
+            owed = cap * dt;
+        }
+        const unsigned due = static_cast<unsigned>(owed / dt);
+        if (due == 0) continue;
+        owed -= static_cast<double>(due) * dt;
+
+        runCommands();
+        if (due > 1) engine.advance(dt, due - 1);
+        recordBefore();
+        engine.advance(dt, 1);
+        steps += due;
+        if (recorder && steps >= nextRecord) {
+            recorder->submit(engine, SnapshotWriter::WhenFull::Skip);
+            nextRecord = steps + recordEvery;
+        }
+
+        // Achieved simulated seconds per wall second, over windows of a quarter second
+        const double time = static_cast<double>(steps) * dt;
+        const double window = std::chrono::duration<double>(now - rateStart).count();
+        if (window >= 0.25) {
+            simRate = static_cast<float>((time - rateStartTime) / window);
+            rateStart = now;
+            rateStartTime = time;
+        }
+        // The newest state belongs to the wall time the accumulator has reached
+        publish(now - std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(owed / warp)),
+                static_cast<float>(dt / warp));
+    }
+    runCommands();
+}
+
+void SimulationThread::runCommands() {
+    {
+        std::lock_guard<std::mutex> lock(commandMutex);
+        runningCommands.swap(commands);
+    }
+    for (auto& command : runningCommands) {
+        command(engine);
+    }
+    runningCommands.clear();
+}
+
+void SimulationThread::recordBefore() {
+    const PhysicsEngine::StateView view = engine.view();
+    before.assign(view.positions.begin(), view.positions.end());
+    beforeHandles.assign(view.handles.begin(), view.handles.end());
+    beforeSlots.clear();
+}
+
+// Copies the state into the writer's buffer and hands it to the reader
+void SimulationThread::publish(Clock::time_point wallTime, float wallStep) {
+    Snapshot& snapshot = snapshots.writeBuffer();
+    const PhysicsEngine::StateView view = engine.view();
+    const size_t count = view.size();
+
+    snapshot.epoch = view.epoch;
+    snapshot.steps = steps;
+    snapshot.time = static_cast<double>(steps) * dt;
+    snapshot.wallTime = wallTime;
+    snapshot.wallStep = wallStep;
+    snapshot.simRate = simRate;
+    snapshot.positions.assign(view.positions.begin(), view.positions.end());
+    snapshot.radii.assign(view.radii.begin(), view.radii.end());
+    snapshot.handles.assign(view.handles.begin(), view.handles.end());
+
+    std::uint32_t slots = 0;
+    for (const BodyHandle& handle : snapshot.handles) {
+        slots = std::max(slots, handle.slot + 1);
+    }
+    snapshot.slotIndex.assign(slots, SlotMap::npos);
+    for (size_t i = 0; i < count; ++i) {
+        snapshot.slotIndex[snapshot.handles[i].slot] = static_cast<std::uint32_t>(i);
+    }
+
+    // Previous positions: index for index unless bodies were added, removed
+    // or merged during the step, in which case they are matched by slot
+    snapshot.previousPositions.resize(count);
+    const bool sameBodies = beforeHandles == snapshot.handles;
+    if (!sameBodies && beforeSlots.empty()) {
+        for (const BodyHandle& handle : beforeHandles) {
+            if (handle.slot >= beforeSlots.size()) beforeSlots.resize(handle.slot + 1, SlotMap::npos);
+        }
+        for (size_t i = 0; i < beforeHandles.size(); ++i) {
+            beforeSlots[beforeHandles[i].slot] = static_cast<std::uint32_t>(i);
+        }
+    }
+    const float box = engine.getConfig().periodicBoxSize;
+    for (size_t i = 0; i < count; ++i) {
+        std::uint32_t from = static_cast<std::uint32_t>(i);
+        if (!sameBodies) {
+            const BodyHandle handle = snapshot.handles[i];
+            from = handle.slot < beforeSlots.size() ? beforeSlots[handle.slot] : SlotMap::npos;
+            if (from != SlotMap::npos && beforeHandles[from] != handle) from = SlotMap::npos;
+        }
+        const glm::vec3& current = snapshot.positions[i];
+        if (from == SlotMap::npos) {
+            snapshot.previousPositions[i] = current;
+        } else if (box > 0.0f) {
+            snapshot.previousPositions[i] = current - Periodic::minimumImage(current - before[from], box);
+        } else {
+            snapshot.previousPositions[i] = before[from];
+        }
+    }
+
+    // Each of the three buffers catches up with track() on its own turn
+    if (snapshot.trackedVersion != trackedVersion) {
+        snapshot.tracked = tracked;
+        snapshot.trackedVersion = trackedVersion;
+    }
+    snapshots.publish();
+}
@@ -0,0 +1,132 @@
+#pragma once
+#include "PhysicsEngine.hpp"
+#include "SnapshotWriter.hpp"
+#include "TripleBuffer.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Runs a PhysicsEngine on its own thread and publishes the body state
+// through a triple buffer. The renderer reads the newest complete snapshot
+// without ever blocking, so a slow step no longer costs frames and vsync no
+// longer stalls physics. The engine belongs to the thread: everything else
+// reaches it through post(), whose commands run between steps.
+//
+// Steps are fixed at dt and driven by an accumulator of elapsed wall time,
+// so the simulation keeps real-time pace whatever the frame rate, or a fixed
+// multiple of it under time warp (the due steps then run as one batch
+// through PhysicsEngine::advance). After a stall at most maxCatchUpSteps
+// real-time steps' worth run at once and the rest of the backlog is
+// dropped, slowing the simulation down instead of spiralling. Snapshots
+// carry the positions from before the last step as well, so the renderer
+// can interpolate between the two.
+class SimulationThread {
+public:
+    using BodyHandle = PhysicsEngine::BodyHandle;
+    using Command = std::function<void(PhysicsEngine&)>;
+    using Clock = std::chrono::steady_clock;
+
+    struct Snapshot {
+        std::uint64_t epoch = 0;        // engine epoch the state was taken at
+        std::uint64_t steps = 0;        // steps run since start()
+        double time = 0.0;              // simulated seconds since start()
+        Clock::time_point wallTime;     // wall-clock time the state belongs to
+        float wallStep = 0.0f;          // wall-clock time the last step spans
+        float simRate = 0.0f;           // achieved simulated seconds per wall second
+        std::vector<glm::vec3> positions;
+        // One step earlier, per body; equal to positions for new bodies.
+        // Periodic wraps are undone so the two can be blended directly.
+        std::vector<glm::vec3> previousPositions;
+        std::vector<float> radii;
+        std::vector<BodyHandle> handles;
+        // Handles passed to track(), e.g. one per config object
+        std::vector<BodyHandle> tracked;
+
+        // Index of the handle's body in the columns above, or SlotMap::npos
+        std::uint32_t find(BodyHandle handle) const;
+
+        // Blend factor for drawing at wall time now: 0 is the previous state,
+        // 1 the newest. Rendering then lags the simulation by one step.
+        float blendAt(Clock::time_point now) const;
+        glm::vec3 interpolatedPosition(std::uint32_t index, float blend) const {
+            return previousPositions[index] + (positions[index] - previousPositions[index]) * blend;
+        }
+
+    private:
+        friend class SimulationThread;
+        std::vector<std::uint32_t> slotIndex;   // slot -> index, for find()
+        std::uint64_t trackedVersion = 0;
+    };
+
+    SimulationThread(const PhysicsConfig& config, float dt);
+    ~SimulationThread();
+    SimulationThread(const SimulationThread&) = delete;
+    SimulationThread& operator=(const SimulationThread&) = delete;
+
+    void start();
+    // Finishes the current step and joins the thread
+    void stop();
+
+    // Most real-time steps run in one go to catch up after a stall
+    void setMaxCatchUpSteps(unsigned steps) { maxCatchUpSteps = steps > 0 ? steps : 1; }
+    // Simulated seconds per wall second wanted, e.g. 1 to 10000
+    void setTimeWarp(double warp) { timeWarp = warp > 0.0 ? warp : 1.0; }
+
+    // Queues a command to run on the simulation thread before its next step.
+    // Commands run in the order they were posted; they also run while stopped
+    // the next time start() is called.
+    void post(Command command);
+
+    // Writes a trajectory frame every `every` steps from the simulation
+    // thread. Frames are skipped while the writer is behind, so stepping never
+    // waits for the disk. nullptr stops recording. Unlike post(), this waits
+    // until the simulation thread has taken the change (at most one step), so
+    // once record(nullptr) or stop() returns the writer can be closed. Call it
+    // from the thread that calls start() and stop().
+    void record(SnapshotWriter* writer, std::uint64_t every);
+
+    // Only from inside a command: handles to republish in every snapshot
+    void track(const std::vector<BodyHandle>& handles);
+
+    // Newest complete snapshot. Never blocks; the reference stays valid until
+    // the next call. Reader side of the triple buffer, so one thread only.
+    const Snapshot& latest();
+
+private:
+    PhysicsEngine engine;
+    float dt;
+    std::uint64_t steps = 0;
+    std::atomic<unsigned> maxCatchUpSteps{8};
+    std::atomic<double> timeWarp{1.0};
+    float simRate = 0.0f;
+
+    // State before the last step, matched to the new state by handle
+    std::vector<glm::vec3> before;
+    std::vector<BodyHandle> beforeHandles;
+    std::vector<std::uint32_t> beforeSlots;
+
+    std::thread thread;
+    std::atomic<bool> running{false};
+
+    std::mutex commandMutex;
+    std::vector<Command> commands;
+    std::vector<Command> runningCommands;
+
+    std::vector<BodyHandle> tracked;
+    std::uint64_t trackedVersion = 0;
+
+    SnapshotWriter* recorder = nullptr;
+    std::uint64_t recordEvery = 1;
+    std::uint64_t nextRecord = 0;
+
+    TripleBuffer<Snapshot> snapshots;
+
+    void run();
+    void runCommands();
+    void recordBefore();
+    void publish(Clock::time_point wallTime, float wallStep);
+};
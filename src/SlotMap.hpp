@@ -0,0 +1,151 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Stable reference to an element of a SlotMap. The slot's generation changes
+// whenever its element is erased, so old handles never alias a newer element.
+struct SlotHandle {
+    std::uint32_t slot = ~0u;
+    std::uint32_t generation = 0;
+
+    bool operator==(const SlotHandle& other) const { return slot == other.slot && generation == other.generation; }
+    bool operator!=(const SlotHandle& other) const { return !(*this == other); }
+};
+
+// Generational slot map from handles to positions in a dense array that the
+// caller owns. insert() and erase() are O(1). On erase the last element moves
+// into the hole, and the caller has to move its data the same way. That keeps
+// the array packed, so kernels can keep iterating over it directly.
+class SlotMap {
+public:
+    static constexpr std::uint32_t npos = ~0u;
+
+    struct Slot {
+        std::uint32_t index;        // dense index, or the next free slot
+        std::uint32_t generation;
+    };
+
+    // Handle for an element appended to the end of the dense array
+    SlotHandle insert() {
+        std::uint32_t slot;
+        if (freeHead != npos) {
+            slot = freeHead;
+            freeHead = slots[slot].index;
+        } else {
+            slot = static_cast<std::uint32_t>(slots.size());
+            slots.push_back({npos, 0});
+        }
+        slots[slot].index = static_cast<std::uint32_t>(dense.size());
+        dense.push_back({slot, slots[slot].generation});
+        return dense.back();
+    }
+
+    // Handles for count elements appended at once; freed slots are reused
+    // first, fresh ones are numbered in a single pass
+    void insert(std::size_t count) {
+        while (count > 0 && freeHead != npos) {
+            insert();
+            --count;
+        }
+        const std::uint32_t firstSlot = static_cast<std::uint32_t>(slots.size());
+        const std::uint32_t firstIndex = static_cast<std::uint32_t>(dense.size());
+        slots.resize(slots.size() + count);
+        dense.resize(dense.size() + count);
+        for (std::uint32_t k = 0; k < count; ++k) {
+            slots[firstSlot + k] = {firstIndex + k, 0};
+            dense[firstIndex + k] = {firstSlot + k, 0};
+        }
+    }
+
+    void reserve(std::size_t count) {
+        slots.reserve(count);
+        dense.reserve(count);
+    }
+
+    // Dense index of the handle's element, or npos once it has been erased
+    std::uint32_t find(SlotHandle handle) const {
+        if (handle.slot >= slots.size() || slots[handle.slot].generation != handle.generation) return npos;
+        return slots[handle.slot].index;
+    }
+
+    // Erases the handle's element and returns its dense index; the caller moves
+    // its last element there and pops. npos (nothing to do) for stale handles.
+    std::uint32_t erase(SlotHandle handle) {
+        std::uint32_t index = find(handle);
+        if (index == npos) return npos;
+        SlotHandle last = dense.back();
+        dense[index] = last;
+        slots[last.slot].index = index;
+        dense.pop_back();
+        release(handle.slot);
+        return index;
+    }
+
+    // Stable in-place removal of every element whose flag is set, matching a
+    // compaction of the dense array that keeps the survivors' order
+    void eraseFlagged(const std::vector<std::uint8_t>& flags) {
+        std::size_t write = 0;
+        for (std::size_t read = 0; read < dense.size(); ++read) {
+            if (flags[read]) {
+                release(dense[read].slot);
+                continue;
+            }
+            dense[write] = dense[read];
+            slots[dense[write].slot].index = static_cast<std::uint32_t>(write);
+            ++write;
+        }
+        dense.resize(write);
+    }
+
+    void clear() {
+        slots.clear();
+        dense.clear();
+        freeHead = npos;
+    }
+
+    // Slot table and free list head, e.g. for saving the map
+    const std::vector<Slot>& getSlots() const { return slots; }
+    std::uint32_t getFreeHead() const { return freeHead; }
+    // Rebuilds the map from a saved slot table holding count live elements.
+    // Returns false, leaving the map unchanged, if the table is inconsistent.
+    bool restore(std::vector<Slot> table, std::uint32_t head, std::size_t count) {
+        // Walk the free list first: the other slots must index every dense position once
+        std::vector<std::uint8_t> isFree(table.size(), 0);
+        std::size_t freeCount = 0;
+        for (std::uint32_t slot = head; slot != npos; slot = table[slot].index) {
+            if (slot >= table.size() || isFree[slot]) return false;
+            isFree[slot] = 1;
+            ++freeCount;
+        }
+        if (table.size() - freeCount != count) return false;
+        std::vector<SlotHandle> handles(count);
+        for (std::uint32_t slot = 0; slot < table.size(); ++slot) {
+            if (isFree[slot]) continue;
+            const std::uint32_t index = table[slot].index;
+            if (index >= count || handles[index].slot != npos) return false;
+            handles[index] = {slot, table[slot].generation};
+        }
+        slots = std::move(table);
+        dense = std::move(handles);
+        freeHead = head;
+        return true;
+    }
+
+    SlotHandle handle(std::size_t index) const { return dense[index]; }
+    // Handle of every element, in dense order
+    const std::vector<SlotHandle>& handles() const { return dense; }
+    std::size_t size() const { return dense.size(); }
+
+private:
+    std::vector<Slot> slots;
+    std::vector<SlotHandle> dense;  // dense index -> handle
+    std::uint32_t freeHead = npos;
+
+    void release(std::uint32_t slot) {
+        ++slots[slot].generation;
+        slots[slot].index = freeHead;
+        freeHead = slot;
+    }
+};
@@ -0,0 +1,265 @@
+#include "SnapshotWriter.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef GRAVITYSIM_HAVE_IO_URING
+#include <liburing.h>
+#endif
+
+#ifdef GRAVITYSIM_HAVE_IO_URING
+struct SnapshotWriter::Ring {
+    io_uring queue;
+    bool ready;
+
+    explicit Ring(unsigned entries) { ready = io_uring_queue_init(entries, &queue, 0) == 0; }
+    ~Ring() {
+        if (ready) io_uring_queue_exit(&queue);
+    }
+};
+#else
+struct SnapshotWriter::Ring {};
+#endif
+
+SnapshotWriter::SnapshotWriter() = default;
+
+SnapshotWriter::~SnapshotWriter() {
+    close();
+}
+
+bool SnapshotWriter::open(const std::string& filename, std::size_t bufferCount) {
+    close();
+    fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::cerr << "Failed to open trajectory file: " << filename << std::endl;
+        return false;
+    }
+    path = filename;
+    index.clear();
+
+    std::vector<char> page(TrajectoryFormat::pageSize, 0);
+    const TrajectoryFormat::FileHeader header = TrajectoryFormat::fileHeader();
+    std::memcpy(page.data(), &header, sizeof(header));
+    if (!writeAll(page.data(), page.size(), 0)) {
+        std::cerr << "Failed to write trajectory file: " << path << std::endl;
+        ::close(fd);
+        fd = -1;
+        return false;
+    }
+    offset = TrajectoryFormat::pageSize;
+
+    // Buffers grow to the frame size on first use
+    buffers.assign(std::max<std::size_t>(bufferCount, 1), Buffer());
+    freeBuffers.clear();
+    for (std::uint32_t i = static_cast<std::uint32_t>(buffers.size()); i-- > 0;) {
+        freeBuffers.push_back(i);
+    }
+    queued.clear();
+    closing = false;
+    failed = false;
+    stats = Stats();
+
+#ifdef GRAVITYSIM_HAVE_IO_URING
+    // Kernels without io_uring, or sandboxes that forbid it, get pwrite
+    ring.reset(new Ring(static_cast<unsigned>(buffers.size())));
+    if (!ring->ready) ring.reset();
+#endif
+    backendName = ring ? "io_uring" : "pwrite";
+    thread = std::thread(&SnapshotWriter::run, this);
+    return true;
+}
+
+bool SnapshotWriter::submit(const PhysicsEngine& engine, WhenFull whenFull) {
+    if (fd < 0) return false;
+    std::uint32_t buffer;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (failed) return false;
+        if (freeBuffers.empty()) {
+            if (whenFull == WhenFull::Skip) {
+                ++stats.skipped;
+                return false;
+            }
+            const auto start = std::chrono::steady_clock::now();
+            bufferFreed.wait(lock, [this] { return !freeBuffers.empty() || failed; });
+            stats.waitSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if (failed) return false;
+        }
+        buffer = freeBuffers.back();
+        freeBuffers.pop_back();
+    }
+
+    // The buffer is ours until it is queued, so the copy runs unlocked
+    const PhysicsEngine::StateView view = engine.view();
+    Buffer& target = buffers[buffer];
+    target.bytes = TrajectoryFormat::frameBytes(view.size());
+    if (target.data.size() < target.bytes) target.data.resize(target.bytes);
+    TrajectoryFormat::packFrame(view, engine.getStepCount(), engine.getTime(), target.data.data());
+    target.offset = offset;
+    target.done = 0;
+    index.push_back({offset, engine.getStepCount(), engine.getTime(), view.size()});
+    offset += target.bytes;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queued.push_back(buffer);
+    }
+    bufferQueued.notify_one();
+    return true;
+}
+
+bool SnapshotWriter::close() {
+    if (fd < 0) return true;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closing = true;
+    }
+    bufferQueued.notify_one();
+    if (thread.joinable()) thread.join();
+    ring.reset();
+
+    // Without the index the file is still readable up to the last complete frame
+    bool ok = !failed;
+    if (ok) {
+        const TrajectoryFormat::Trailer end = TrajectoryFormat::trailer(offset, index.size());
+        const std::uint64_t indexBytes = index.size() * sizeof(TrajectoryFormat::FrameEntry);
+        ok = writeAll(reinterpret_cast<const char*>(index.data()), indexBytes, offset) &&
+             writeAll(reinterpret_cast<const char*>(&end), sizeof(end), offset + indexBytes);
+        if (!ok) {
+            std::cerr << "Failed to write trajectory index: " << path << std::endl;
+        }
+    }
+    ::close(fd);
+    fd = -1;
+    return ok;
+}
+
+SnapshotWriter::Stats SnapshotWriter::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+// Writer thread: one buffer at a time through pwrite
+void SnapshotWriter::run() {
+#ifdef GRAVITYSIM_HAVE_IO_URING
+    if (ring) {
+        runRing();
+        return;
+    }
+#endif
+    for (;;) {
+        std::uint32_t buffer;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            bufferQueued.wait(lock, [this] { return !queued.empty() || closing; });
+            if (queued.empty()) return;
+            buffer = queued.front();
+            queued.pop_front();
+        }
+        const Buffer& source = buffers[buffer];
+        release(buffer, writeAll(source.data.data(), source.bytes, source.offset));
+    }
+}
+
+#ifdef GRAVITYSIM_HAVE_IO_URING
+// Writer thread: every queued buffer is submitted at once and the thread
+// sleeps in the kernel until one of them completes
+void SnapshotWriter::runRing() {
+    io_uring* queue = &ring->queue;
+    unsigned inFlight = 0;
+    std::vector<std::uint32_t> batch;
+
+    // Writes what is left of a buffer, at most 1 GB per request
+    auto start = [&](std::uint32_t buffer) {
+        const Buffer& source = buffers[buffer];
+        io_uring_sqe* sqe = io_uring_get_sqe(queue);
+        if (!sqe) {
+            io_uring_submit(queue);
+            sqe = io_uring_get_sqe(queue);
+        }
+        const std::uint64_t bytes = std::min<std::uint64_t>(source.bytes - source.done, 1u << 30);
+        io_uring_prep_write(sqe, fd, source.data.data() + source.done, static_cast<unsigned>(bytes),
+                            source.offset + source.done);
+        io_uring_sqe_set_data(sqe, reinterpret_cast<void*>(static_cast<std::uintptr_t>(buffer)));
+        ++inFlight;
+    };
+
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (inFlight == 0) bufferQueued.wait(lock, [this] { return !queued.empty() || closing; });
+            if (queued.empty() && inFlight == 0) return;
+            batch.assign(queued.begin(), queued.end());
+            queued.clear();
+        }
+        for (std::uint32_t buffer : batch) {
+            start(buffer);
+        }
+
+        const int result = io_uring_submit_and_wait(queue, 1);
+        if (result < 0 && result != -EINTR && result != -EAGAIN && result != -EBUSY) {
+            // The ring itself broke; give up on the file rather than guess which writes landed
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                failed = true;
+            }
+            std::cerr << "Failed to write trajectory file: " << path << " (" << std::strerror(-result) << ")"
+                      << std::endl;
+            bufferFreed.notify_all();
+            return;
+        }
+
+        io_uring_cqe* cqe;
+        while (io_uring_peek_cqe(queue, &cqe) == 0) {
+            const std::uint32_t buffer =
+                static_cast<std::uint32_t>(reinterpret_cast<std::uintptr_t>(io_uring_cqe_get_data(cqe)));
+            const int written = cqe->res;
+            io_uring_cqe_seen(queue, cqe);
+            --inFlight;
+            if (written == -EINTR || written == -EAGAIN) {
+                start(buffer);
+            } else if (written <= 0) {
+                release(buffer, false);
+            } else if ((buffers[buffer].done += static_cast<std::uint64_t>(written)) < buffers[buffer].bytes) {
+                start(buffer);
+            } else {
+                release(buffer, true);
+            }
+        }
+    }
+}
+#endif
+
+void SnapshotWriter::release(std::uint32_t buffer, bool ok) {
+    bool report;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        report = !ok && !failed;
+        if (ok) {
+            ++stats.written;
+        } else {
+            failed = true;
+        }
+        freeBuffers.push_back(buffer);
+    }
+    if (report) {
+        std::cerr << "Failed to write trajectory file: " << path << std::endl;
+    }
+    bufferFreed.notify_one();
+}
+
+bool SnapshotWriter::writeAll(const char* data, std::uint64_t bytes, std::uint64_t at) {
+    while (bytes > 0) {
+        const ssize_t written = pwrite(fd, data, static_cast<size_t>(std::min<std::uint64_t>(bytes, 1u << 30)),
+                                       static_cast<off_t>(at));
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) return false;
+        data += written;
+        bytes -= static_cast<std::uint64_t>(written);
+        at += static_cast<std::uint64_t>(written);
+    }
+    return true;
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include "PhysicsEngine.hpp"
+#include "Trajectory.hpp"
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Writes trajectory frames (see Trajectory.hpp) on a thread of its own, so
+// the stepping thread only pays for copying the state out. submit() packs
+// the engine's state into one of a fixed pool of buffers and queues it; the
+// writer thread sends queued buffers to disk and hands them back. Each
+// frame's file offset is assigned when it is queued, so writes can complete
+// in any order.
+//
+// The pool bounds memory: with every buffer queued or in flight, submit()
+// either waits for one to come back (no frame is lost, the step stalls for
+// as long as the disk is behind) or skips the frame (the step never stalls,
+// the file gets gaps). Frames go out through io_uring, several in flight at
+// once, when the build found liburing and the kernel allows it, and through
+// pwrite otherwise.
+class SnapshotWriter {
+public:
+    enum class WhenFull { Wait, Skip };
+
+    struct Stats {
+        std::uint64_t written = 0;      // frames on disk
+        std::uint64_t skipped = 0;      // frames dropped by WhenFull::Skip
+        double waitSeconds = 0.0;       // time submit() spent waiting for a buffer
+    };
+
+    SnapshotWriter();
+    SnapshotWriter(const SnapshotWriter&) = delete;
+    SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+    ~SnapshotWriter();
+
+    // At most bufferCount frames are queued or being written at a time
+    bool open(const std::string& filename, std::size_t bufferCount = 4);
+    // Queues the engine's current state as the next frame; one thread only.
+    // Returns false if the frame was skipped or an earlier write failed.
+    bool submit(const PhysicsEngine& engine, WhenFull whenFull = WhenFull::Wait);
+    // Waits for the queued frames, then writes the index and trailer
+    bool close();
+
+    Stats getStats() const;
+    // "io_uring" or "pwrite", as chosen by the last open()
+    const char* backend() const { return backendName; }
+
+private:
+    struct Buffer {
+        std::vector<char> data;
+        std::uint64_t offset = 0;       // in the file
+        std::uint64_t bytes = 0;
+        std::uint64_t done = 0;         // bytes already written
+    };
+    struct Ring;                        // io_uring state, when built with liburing
+
+    int fd = -1;
+    std::string path;
+    std::uint64_t offset = 0;           // where the next frame goes
+    std::vector<TrajectoryFormat::FrameEntry> index;
+
+    std::vector<Buffer> buffers;
+    std::vector<std::uint32_t> freeBuffers;
+    std::deque<std::uint32_t> queued;
+    mutable std::mutex mutex;
+    std::condition_variable bufferFreed;
+    std::condition_variable bufferQueued;
+    bool closing = false;
+    bool failed = false;
+    Stats stats;
+
+    std::unique_ptr<Ring> ring;
+    const char* backendName = "pwrite";
+    std::thread thread;
+
+    void run();
+    void runRing();
+    void release(std::uint32_t buffer, bool ok);
+    bool writeAll(const char* data, std::uint64_t bytes, std::uint64_t at);
+};
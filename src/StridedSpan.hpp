@@ -0,0 +1,72 @@
+#pragma once
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+
+// Non-owning view of count elements placed strideBytes apart, e.g. one field
+// of every element of an array of structs. Reading a column through it does
+// not copy anything.
+template <class T>
+class StridedSpan {
+    using Byte = std::conditional_t<std::is_const<T>::value, const unsigned char, unsigned char>;
+
+public:
+    class iterator {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = std::remove_cv_t<T>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = T*;
+        using reference = T&;
+
+        iterator() = default;
+        iterator(Byte* at, std::size_t stride) : at(at), stride(stride) {}
+
+        T& operator*() const { return *reinterpret_cast<T*>(at); }
+        T* operator->() const { return reinterpret_cast<T*>(at); }
+        T& operator[](difference_type n) const { return *(*this + n); }
+        iterator& operator++() { at += stride; return *this; }
+        iterator operator++(int) { iterator old = *this; at += stride; return old; }
+        iterator& operator--() { at -= stride; return *this; }
+        iterator operator--(int) { iterator old = *this; at -= stride; return old; }
+        iterator& operator+=(difference_type n) { at += n * static_cast<difference_type>(stride); return *this; }
+        iterator& operator-=(difference_type n) { at -= n * static_cast<difference_type>(stride); return *this; }
+        friend iterator operator+(iterator it, difference_type n) { return it += n; }
+        friend iterator operator+(difference_type n, iterator it) { return it += n; }
+        friend iterator operator-(iterator it, difference_type n) { return it -= n; }
+        friend difference_type operator-(const iterator& a, const iterator& b) {
+            return (a.at - b.at) / static_cast<difference_type>(a.stride);
+        }
+        bool operator==(const iterator& other) const { return at == other.at; }
+        bool operator!=(const iterator& other) const { return at != other.at; }
+        bool operator<(const iterator& other) const { return at < other.at; }
+        bool operator>(const iterator& other) const { return at > other.at; }
+        bool operator<=(const iterator& other) const { return at <= other.at; }
+        bool operator>=(const iterator& other) const { return at >= other.at; }
+
+    private:
+        Byte* at = nullptr;
+        std::size_t stride = sizeof(T);
+    };
+
+    StridedSpan() = default;
+    StridedSpan(T* first, std::size_t count, std::size_t strideBytes = sizeof(T))
+        : first(reinterpret_cast<Byte*>(first)), count(count), strideBytes(strideBytes) {}
+
+    T& operator[](std::size_t i) const { return *reinterpret_cast<T*>(first + i * strideBytes); }
+    T* data() const { return reinterpret_cast<T*>(first); }
+    std::size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    // Distance between consecutive elements in bytes
+    std::size_t stride() const { return strideBytes; }
+    // Elements are packed, so data() can be used as a plain array
+    bool contiguous() const { return strideBytes == sizeof(T); }
+
+    iterator begin() const { return iterator(first, strideBytes); }
+    iterator end() const { return iterator(first + count * strideBytes, strideBytes); }
+
+private:
+    Byte* first = nullptr;
+    std::size_t count = 0;
+    std::size_t strideBytes = sizeof(T);
+};
@@ -0,0 +1,318 @@
+#include "TaskScheduler.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <ostream>
+#include <utility>
+
+// Slots not held by any thread; shared with the threads holding one, so a
+// thread that outlives its scheduler can still give its slot back
+struct TaskScheduler::ExternalSlots {
+    std::mutex mutex;
+    std::vector<unsigned> free;
+};
+
+namespace {
+    // Identity of a worker thread; threads outside any scheduler keep owner null
+    struct ThreadSlot {
+        const TaskScheduler* owner = nullptr;
+        unsigned index = 0;
+        int depth = 0;            // nesting of task execution, busy time is taken at depth 0
+        std::uint32_t rng = 0x9e3779b9u;
+    };
+    thread_local ThreadSlot slot;
+
+    std::uint32_t nextRandom() {
+        // xorshift32 for victim selection
+        std::uint32_t x = slot.rng;
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        slot.rng = x;
+        return x;
+    }
+}
+
+TaskScheduler::TaskScheduler(unsigned threadCount)
+    : threadCount(std::max(threadCount, 1u)), external(std::make_shared<ExternalSlots>()) {
+    for (unsigned i = 0; i < this->threadCount + maxExternalThreads - 1; ++i) {
+        workers.push_back(std::make_unique<Worker>());
+    }
+    // Slot 0 and the slots past the workers belong to threads that submit
+    // work; the lowest free one is handed out first
+    for (unsigned i = static_cast<unsigned>(workers.size()); i-- > this->threadCount;) {
+        external->free.push_back(i);
+    }
+    external->free.push_back(0);
+    for (unsigned i = 1; i < this->threadCount; ++i) {
+        threads.emplace_back(&TaskScheduler::workerLoop, this, i);
+    }
+}
+
+TaskScheduler::~TaskScheduler() {
+    stopping = true;
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    wake.notify_all();
+    for (auto& t : threads) {
+        t.join();
+    }
+}
+
+TaskScheduler& TaskScheduler::instance() {
+    // GRAVITYSIM_THREADS overrides the detected core count
+    static TaskScheduler scheduler([]() {
+        const char* env = std::getenv("GRAVITYSIM_THREADS");
+        int requested = env ? std::atoi(env) : 0;
+        return requested > 0 ? static_cast<unsigned>(requested) : std::thread::hardware_concurrency();
+    }());
+    return scheduler;
+}
+
+unsigned TaskScheduler::currentWorker() const {
+    return slot.owner == this ? slot.index : claimExternalSlot();
+}
+
+unsigned TaskScheduler::claimExternalSlot() const {
+    // Slots this thread holds, one per scheduler it has called into;
+    // handed back when the thread exits
+    struct Claims {
+        std::vector<std::pair<std::shared_ptr<ExternalSlots>, unsigned>> held;
+        ~Claims() {
+            for (auto& claim : held) {
+                std::lock_guard<std::mutex> lock(claim.first->mutex);
+                claim.first->free.push_back(claim.second);
+            }
+        }
+    };
+    thread_local Claims claims;
+    for (const auto& claim : claims.held) {
+        if (claim.first == external) return claim.second;
+    }
+    unsigned index;
+    {
+        std::lock_guard<std::mutex> lock(external->mutex);
+        if (external->free.empty()) {
+            std::cerr << "TaskScheduler: more than " << maxExternalThreads
+                      << " threads outside it submit work" << std::endl;
+            std::abort();
+        }
+        index = external->free.back();
+        external->free.pop_back();
+    }
+    claims.held.emplace_back(external, index);
+    return index;
+}
+
+void TaskScheduler::spawn(TaskGroup& group, std::function<void()> task) {
+    group.pending.fetch_add(1);
+    Worker& worker = *workers[currentWorker()];
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.tasks.emplace_back([&group, task = std::move(task)]() {
+            task();
+            group.pending.fetch_sub(1);
+        });
+    }
+    queuedTasks.fetch_add(1);
+    // A sleeper registers before re-checking queuedTasks under sleepMutex,
+    // so taking the mutex here guarantees it either sees the task or the notify
+    if (sleepers.load() > 0) {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+        }
+        wake.notify_one();
+    }
+}
+
+void TaskScheduler::wait(TaskGroup& group) {
+    const unsigned index = currentWorker();
+    while (group.pending.load() > 0) {
+        if (!tryRunOne(index)) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void TaskScheduler::parallelFor(std::size_t count, std::size_t grain,
+                                const std::function<void(std::size_t, std::size_t)>& body) {
+    if (count == 0) return;
+    grain = std::max<std::size_t>(grain, 1);
+    const unsigned index = currentWorker();
+    std::function<void()> root;
+    TaskGroup group;
+    if (count <= grain || workers.size() == 1) {
+        root = [&]() { body(0, count); };
+    } else {
+        root = [&]() { splitRange(group, 0, count, grain, body); };
+    }
+    // The caller's own share counts as a task so busy time covers it too
+    execute(index, root);
+    wait(group);
+}
+
+void TaskScheduler::parallelForRanges(const std::vector<std::size_t>& bounds,
+                                      const std::function<void(std::size_t, std::size_t)>& body) {
+    if (bounds.size() < 2) return;
+    TaskGroup group;
+    for (std::size_t k = 1; k + 1 < bounds.size(); ++k) {
+        if (bounds[k] == bounds[k + 1]) continue;
+        std::size_t begin = bounds[k], end = bounds[k + 1];
+        spawn(group, [begin, end, &body]() { body(begin, end); });
+    }
+    std::function<void()> first = [&]() {
+        if (bounds[0] != bounds[1]) body(bounds[0], bounds[1]);
+    };
+    execute(currentWorker(), first);
+    wait(group);
+}
+
+std::vector<std::size_t> TaskScheduler::partitionByCost(const std::vector<std::uint32_t>& costs, std::size_t parts) {
+    parts = std::max<std::size_t>(parts, 1);
+    std::uint64_t total = 0;
+    for (std::uint32_t c : costs) {
+        total += std::max<std::uint32_t>(c, 1);
+    }
+
+    std::vector<std::size_t> bounds;
+    bounds.reserve(parts + 1);
+    bounds.push_back(0);
+    std::uint64_t running = 0;
+    std::size_t i = 0;
+    for (std::size_t k = 1; k < parts; ++k) {
+        const std::uint64_t target = total * k / parts;
+        while (i < costs.size() && running + std::max<std::uint32_t>(costs[i], 1) <= target) {
+            running += std::max<std::uint32_t>(costs[i], 1);
+            ++i;
+        }
+        bounds.push_back(i);
+    }
+    bounds.push_back(costs.size());
+    return bounds;
+}
+
+void TaskScheduler::splitRange(TaskGroup& group, std::size_t begin, std::size_t end, std::size_t grain,
+                               const std::function<void(std::size_t, std::size_t)>& body) {
+    // Keep the left half, expose the right half to thieves
+    while (end - begin > grain) {
+        std::size_t mid = begin + (end - begin) / 2;
+        spawn(group, [this, &group, mid, end, grain, &body]() {
+            splitRange(group, mid, end, grain, body);
+        });
+        end = mid;
+    }
+    body(begin, end);
+}
+
+bool TaskScheduler::tryRunOne(unsigned index) {
+    std::function<void()> task;
+
+    // Own deque first, newest task
+    {
+        Worker& own = *workers[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+        }
+    }
+
+    // Otherwise steal the oldest task of a random victim
+    if (!task && workers.size() > 1) {
+        const std::size_t count = workers.size();
+        std::size_t start = nextRandom() % count;
+        for (std::size_t k = 0; k < count && !task; ++k) {
+            std::size_t victim = (start + k) % count;
+            if (victim == index) continue;
+            Worker& other = *workers[victim];
+            std::lock_guard<std::mutex> lock(other.mutex);
+            if (!other.tasks.empty()) {
+                task = std::move(other.tasks.front());
+                other.tasks.pop_front();
+                workers[index]->tasksStolen.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    if (!task) return false;
+    queuedTasks.fetch_sub(1);
+    execute(index, task);
+    return true;
+}
+
+void TaskScheduler::execute(unsigned index, std::function<void()>& task) {
+    Worker& worker = *workers[index];
+    if (slot.depth++ > 0) {
+        // Nested inside another task's wait: already being timed
+        task();
+    } else {
+        auto start = std::chrono::steady_clock::now();
+        task();
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        worker.busyNanoseconds.fetch_add(
+            static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()),
+            std::memory_order_relaxed);
+    }
+    --slot.depth;
+    worker.tasksRun.fetch_add(1, std::memory_order_relaxed);
+}
+
+void TaskScheduler::workerLoop(unsigned index) {
+    slot.owner = this;
+    slot.index = index;
+    slot.rng = 0x9e3779b9u * (index + 1);
+
+    while (!stopping) {
+        if (tryRunOne(index)) continue;
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleepers.fetch_add(1);
+        wake.wait(lock, [this]() { return stopping || queuedTasks.load() > 0; });
+        sleepers.fetch_sub(1);
+    }
+}
+
+std::vector<TaskScheduler::ThreadStats> TaskScheduler::getStats() const {
+    std::vector<ThreadStats> stats;
+    for (const auto& worker : workers) {
+        stats.push_back({worker->busyNanoseconds.load() * 1e-9,
+                         worker->tasksRun.load(),
+                         worker->tasksStolen.load()});
+    }
+    return stats;
+}
+
+void TaskScheduler::resetStats() {
+    for (auto& worker : workers) {
+        worker->busyNanoseconds = 0;
+        worker->tasksRun = 0;
+        worker->tasksStolen = 0;
+    }
+}
+
+void TaskScheduler::printStats(std::ostream& out) const {
+    std::vector<ThreadStats> stats = getStats();
+    // Extra slots for outside threads only count once a thread has used them
+    auto shown = [&](std::size_t i) { return i < threadCount || stats[i].tasksRun > 0; };
+    double total = 0.0, busiest = 0.0;
+    std::size_t rows = 0;
+    for (std::size_t i = 0; i < stats.size(); ++i) {
+        if (!shown(i)) continue;
+        total += stats[i].busySeconds;
+        busiest = std::max(busiest, stats[i].busySeconds);
+        ++rows;
+    }
+    out << "Thread  busy(ms)    tasks   stolen" << std::endl;
+    for (std::size_t i = 0; i < stats.size(); ++i) {
+        if (!shown(i)) continue;
+        out << std::setw(6) << i << std::setw(10) << std::fixed << std::setprecision(2)
+            << stats[i].busySeconds * 1000.0 << std::setw(9) << stats[i].tasksRun
+            << std::setw(9) << stats[i].tasksStolen << std::endl;
+    }
+    double mean = total / static_cast<double>(rows);
+    out << "Load imbalance (max/mean busy): " << std::setprecision(2)
+        << (mean > 0.0 ? busiest / mean : 1.0) << std::endl;
+}
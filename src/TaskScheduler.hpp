@@ -0,0 +1,101 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing task scheduler. Every worker owns a deque: it pushes and
+// pops its own tasks at the back (LIFO, cache friendly) while idle workers
+// steal from the front of a randomly chosen victim, which hands out the
+// largest pending chunks first. Threads that are not workers (the main
+// thread, a simulation thread, ...) are each given a slot of their own the
+// first time they call in, and help while they wait. Slot 0 plus
+// maxExternalThreads - 1 extra slots are kept for them; a slot is returned
+// when its thread exits. Running out of them is a programming error.
+class TaskScheduler {
+public:
+    // Counts tasks spawned into it that have not finished yet
+    struct TaskGroup {
+        std::atomic<std::size_t> pending{0};
+    };
+
+    struct ThreadStats {
+        double busySeconds;       // time spent running tasks
+        std::uint64_t tasksRun;
+        std::uint64_t tasksStolen;
+    };
+
+    // Threads outside the scheduler that may submit work at the same time
+    static constexpr unsigned maxExternalThreads = 8;
+
+    explicit TaskScheduler(unsigned threadCount = std::thread::hardware_concurrency());
+    ~TaskScheduler();
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+    // Process-wide scheduler shared by every engine
+    static TaskScheduler& instance();
+
+    void spawn(TaskGroup& group, std::function<void()> task);
+    // Runs pending tasks on the calling thread until the group is empty
+    void wait(TaskGroup& group);
+
+    // Calls body(begin, end) over [0, count) split down to chunks of at most
+    // grain items; halves are pushed for stealing as the range is divided
+    void parallelFor(std::size_t count, std::size_t grain,
+                     const std::function<void(std::size_t, std::size_t)>& body);
+
+    // Runs body once per range [bounds[k], bounds[k + 1]), each as its own task
+    void parallelForRanges(const std::vector<std::size_t>& bounds,
+                           const std::function<void(std::size_t, std::size_t)>& body);
+
+    // Splits [0, costs.size()) into parts contiguous ranges of roughly equal
+    // total cost; returns parts + 1 boundaries. Zero costs count as one.
+    static std::vector<std::size_t> partitionByCost(const std::vector<std::uint32_t>& costs, std::size_t parts);
+
+    // Worker threads plus the calling thread; use it to decide how many parts to split work into
+    unsigned getThreadCount() const { return threadCount; }
+    // Bound on currentWorker(); size per-thread scratch with this
+    unsigned getSlotCount() const { return static_cast<unsigned>(workers.size()); }
+    // Index of the calling thread's slot, usable for per-thread scratch.
+    // No two threads have the same index at the same time.
+    unsigned currentWorker() const;
+
+    std::vector<ThreadStats> getStats() const;
+    void resetStats();
+    void printStats(std::ostream& out) const;
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+        std::atomic<std::uint64_t> busyNanoseconds{0};
+        std::atomic<std::uint64_t> tasksRun{0};
+        std::atomic<std::uint64_t> tasksStolen{0};
+    };
+
+    struct ExternalSlots;               // free slots for threads that are not workers
+
+    unsigned threadCount;
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+    std::shared_ptr<ExternalSlots> external;
+    std::atomic<std::size_t> queuedTasks{0};
+    std::atomic<int> sleepers{0};
+    std::atomic<bool> stopping{false};
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+
+    unsigned claimExternalSlot() const;
+    void workerLoop(unsigned index);
+    bool tryRunOne(unsigned index);
+    void execute(unsigned index, std::function<void()>& task);
+    void splitRange(TaskGroup& group, std::size_t begin, std::size_t end, std::size_t grain,
+                    const std::function<void(std::size_t, std::size_t)>& body);
+};
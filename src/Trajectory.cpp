@@ -0,0 +1,220 @@
+#include "Trajectory.hpp"
+#include "TaskScheduler.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+    using namespace TrajectoryFormat;
+
+    const char fileMagic[8] = {'G', 'S', 'I', 'M', 'T', 'R', 'A', 'J'};
+    const char frameMagic[8] = {'G', 'S', 'I', 'M', 'F', 'R', 'A', 'M'};
+    const char indexMagic[8] = {'G', 'S', 'I', 'M', 'I', 'N', 'D', 'X'};
+    const std::uint32_t byteOrderMark = 0x01020304u;
+
+    static_assert(sizeof(FileHeader) == 64 && sizeof(FrameHeader) == 64, "header layouts are part of the format");
+    static_assert(sizeof(FrameEntry) == 32 && sizeof(Trailer) == 32, "index layouts are part of the format");
+
+    std::uint64_t roundUp(std::uint64_t value, std::uint64_t multiple) {
+        return (value + multiple - 1) / multiple * multiple;
+    }
+}
+
+std::uint64_t TrajectoryFormat::columnStride(std::uint64_t bodyCount) {
+    return roundUp(bodyCount * sizeof(float), columnAlignment);
+}
+
+std::uint64_t TrajectoryFormat::frameBytes(std::uint64_t bodyCount) {
+    return roundUp(sizeof(FrameHeader) + ColumnCount * columnStride(bodyCount), pageSize);
+}
+
+void TrajectoryFormat::packFrame(const PhysicsEngine::StateView& view, std::uint64_t step, double time, char* buffer) {
+    const std::uint64_t count = view.size();
+    const std::uint64_t stride = columnStride(count);
+    const std::uint64_t bytes = frameBytes(count);
+
+    FrameHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, frameMagic, sizeof(frameMagic));
+    header.frameBytes = bytes;
+    header.step = step;
+    header.time = time;
+    header.bodyCount = count;
+    header.columnStride = stride;
+    std::memcpy(buffer, &header, sizeof(header));
+
+    char* columns = buffer + sizeof(FrameHeader);
+    auto floats = [&](Column c) { return reinterpret_cast<float*>(columns + c * stride); };
+    auto words = [&](Column c) { return reinterpret_cast<std::uint32_t*>(columns + c * stride); };
+    float* x = floats(X); float* y = floats(Y); float* z = floats(Z);
+    float* vx = floats(VX); float* vy = floats(VY); float* vz = floats(VZ);
+    float* mass = floats(Mass); float* radius = floats(Radius);
+    std::uint32_t* slot = words(Slot); std::uint32_t* generation = words(Generation);
+    TaskScheduler::instance().parallelFor(count, 65536, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            const glm::vec3& p = view.positions[i];
+            const glm::vec3& v = view.velocities[i];
+            x[i] = p.x; y[i] = p.y; z[i] = p.z;
+            vx[i] = v.x; vy[i] = v.y; vz[i] = v.z;
+            mass[i] = view.masses[i];
+            radius[i] = view.radii[i];
+            slot[i] = view.handles[i].slot;
+            generation[i] = view.handles[i].generation;
+        }
+    });
+
+    // Zero the gaps so no stale memory reaches the file
+    for (std::uint32_t c = 0; c < ColumnCount; ++c) {
+        char* tail = columns + c * stride + count * sizeof(float);
+        std::memset(tail, 0, stride - count * sizeof(float));
+    }
+    char* end = columns + ColumnCount * stride;
+    std::memset(end, 0, buffer + bytes - end);
+}
+
+FileHeader TrajectoryFormat::fileHeader() {
+    FileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, fileMagic, sizeof(fileMagic));
+    header.version = version;
+    header.byteOrder = byteOrderMark;
+    header.pageSize = static_cast<std::uint32_t>(pageSize);
+    header.columnCount = ColumnCount;
+    return header;
+}
+
+Trailer TrajectoryFormat::trailer(std::uint64_t indexOffset, std::uint64_t frameCount) {
+    Trailer trailer;
+    std::memset(&trailer, 0, sizeof(trailer));
+    std::memcpy(trailer.magic, indexMagic, sizeof(indexMagic));
+    trailer.indexOffset = indexOffset;
+    trailer.frameCount = frameCount;
+    return trailer;
+}
+
+TrajectoryReader::~TrajectoryReader() {
+    close();
+}
+
+bool TrajectoryReader::open(const std::string& filename) {
+    close();
+    const int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Failed to open trajectory file: " << filename << std::endl;
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<std::uint64_t>(info.st_size) < pageSize) {
+        ::close(fd);
+        std::cerr << "Not a trajectory file: " << filename << std::endl;
+        return false;
+    }
+    size = static_cast<std::uint64_t>(info.st_size);
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        size = 0;
+        std::cerr << "Failed to map trajectory file: " << filename << std::endl;
+        return false;
+    }
+    data = static_cast<const char*>(mapping);
+
+    FileHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, fileMagic, sizeof(fileMagic)) != 0 || header.version > version ||
+        header.byteOrder != byteOrderMark || header.pageSize != pageSize || header.columnCount != ColumnCount) {
+        std::cerr << "Not a readable trajectory file: " << filename << std::endl;
+        close();
+        return false;
+    }
+    if (!readIndex()) {
+        rebuildIndex();
+        std::cerr << "Trajectory " << filename << " has no index, recovered " << frames << " frames" << std::endl;
+    }
+    return true;
+}
+
+void TrajectoryReader::close() {
+    if (data) {
+        munmap(const_cast<char*>(data), size);
+    }
+    data = nullptr;
+    size = 0;
+    entries = nullptr;
+    frames = 0;
+    rebuiltIndex.clear();
+}
+
+bool TrajectoryReader::readIndex() {
+    if (size < pageSize + sizeof(Trailer)) return false;
+    Trailer trailer;
+    std::memcpy(&trailer, data + size - sizeof(Trailer), sizeof(trailer));
+    if (std::memcmp(trailer.magic, indexMagic, sizeof(indexMagic)) != 0 || trailer.indexOffset < pageSize ||
+        trailer.indexOffset % pageSize != 0 || trailer.indexOffset > size ||
+        trailer.frameCount > (size - trailer.indexOffset) / sizeof(FrameEntry) ||
+        trailer.indexOffset + trailer.frameCount * sizeof(FrameEntry) + sizeof(Trailer) != size) {
+        return false;
+    }
+    entries = reinterpret_cast<const FrameEntry*>(data + trailer.indexOffset);
+    frames = static_cast<std::size_t>(trailer.frameCount);
+    return true;
+}
+
+// Frames carry their own size, so they can be walked from the first one
+// up to the first incomplete or missing frame
+void TrajectoryReader::rebuildIndex() {
+    rebuiltIndex.clear();
+    std::uint64_t offset = pageSize;
+    while (offset + sizeof(FrameHeader) <= size) {
+        FrameHeader header;
+        std::memcpy(&header, data + offset, sizeof(header));
+        if (std::memcmp(header.magic, frameMagic, sizeof(frameMagic)) != 0 ||
+            header.bodyCount > size / sizeof(float) || header.frameBytes != frameBytes(header.bodyCount) ||
+            header.columnStride != columnStride(header.bodyCount) || header.frameBytes > size - offset) {
+            break;
+        }
+        rebuiltIndex.push_back({offset, header.step, header.time, header.bodyCount});
+        offset += header.frameBytes;
+    }
+    entries = rebuiltIndex.data();
+    frames = rebuiltIndex.size();
+}
+
+bool TrajectoryReader::frame(std::size_t number, Frame& out) const {
+    if (number >= frames) return false;
+    const FrameEntry& entry = entries[number];
+    if (entry.offset % pageSize != 0 || entry.offset > size || size - entry.offset < sizeof(FrameHeader)) return false;
+    const FrameHeader* header = reinterpret_cast<const FrameHeader*>(data + entry.offset);
+    if (std::memcmp(header->magic, frameMagic, sizeof(frameMagic)) != 0 || header->bodyCount != entry.bodyCount ||
+        header->bodyCount > size / sizeof(float) || header->frameBytes != frameBytes(header->bodyCount) ||
+        header->columnStride != columnStride(header->bodyCount) || header->frameBytes > size - entry.offset) {
+        return false;
+    }
+    const char* columns = data + entry.offset + sizeof(FrameHeader);
+    const std::uint64_t stride = header->columnStride;
+    out.step = header->step;
+    out.time = header->time;
+    out.bodyCount = static_cast<std::size_t>(header->bodyCount);
+    for (std::uint32_t c = 0; c < Slot; ++c) {
+        out.columns[c] = reinterpret_cast<const float*>(columns + c * stride);
+    }
+    out.slots = reinterpret_cast<const std::uint32_t*>(columns + Slot * stride);
+    out.generations = reinterpret_cast<const std::uint32_t*>(columns + Generation * stride);
+    return true;
+}
+
+std::size_t TrajectoryReader::findStep(std::uint64_t step) const {
+    const FrameEntry* found = std::lower_bound(entries, entries + frames, step,
+                                               [](const FrameEntry& e, std::uint64_t s) { return e.step < s; });
+    return static_cast<std::size_t>(found - entries);
+}
+
+std::size_t TrajectoryReader::findTime(double time) const {
+    const FrameEntry* found = std::lower_bound(entries, entries + frames, time,
+                                               [](const FrameEntry& e, double t) { return e.time < t; });
+    return static_cast<std::size_t>(found - entries);
+}
@@ -0,0 +1,118 @@
+#pragma once
+#include "PhysicsEngine.hpp"
+#include "SlotMap.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Chunked columnar trajectory file. Every frame is a page-aligned block
+// holding one column per body field (structure of arrays), so a reader
+// that maps the file can hand out pointers straight into it. An index of
+// every frame's offset, step and time follows the last frame, and a
+// fixed-size trailer at the very end points to it, so any frame is found
+// with one binary search and no parsing.
+//
+//   page 0        FileHeader
+//   frame k       FrameHeader, then the columns x y z vx vy vz mass radius
+//                 slot generation, each columnStride bytes apart (64-byte
+//                 aligned), padded to a whole number of pages
+//   after frames  FrameEntry per frame, then the Trailer
+//
+// Values are in native byte order; the header records it. If the writer
+// stopped before the index was written, the reader rebuilds it by walking
+// the frame headers.
+namespace TrajectoryFormat {
+    constexpr std::uint32_t version = 1;
+    constexpr std::uint64_t pageSize = 4096;
+    constexpr std::uint64_t columnAlignment = 64;
+
+    enum Column : std::uint32_t { X, Y, Z, VX, VY, VZ, Mass, Radius, Slot, Generation, ColumnCount };
+
+    struct FileHeader {
+        char magic[8];              // "GSIMTRAJ"
+        std::uint32_t version;
+        std::uint32_t byteOrder;
+        std::uint32_t pageSize;
+        std::uint32_t columnCount;
+        std::uint64_t reserved[5];
+    };
+
+    struct FrameHeader {
+        char magic[8];              // "GSIMFRAM"
+        std::uint64_t frameBytes;   // whole pages, header included
+        std::uint64_t step;
+        double time;
+        std::uint64_t bodyCount;
+        std::uint64_t columnStride;
+        std::uint64_t reserved[2];
+    };
+
+    struct FrameEntry {
+        std::uint64_t offset;
+        std::uint64_t step;
+        double time;
+        std::uint64_t bodyCount;
+    };
+
+    struct Trailer {
+        char magic[8];              // "GSIMINDX"
+        std::uint64_t indexOffset;
+        std::uint64_t frameCount;
+        std::uint64_t reserved;
+    };
+
+    // Bytes between columns and of a whole frame for bodyCount bodies
+    std::uint64_t columnStride(std::uint64_t bodyCount);
+    std::uint64_t frameBytes(std::uint64_t bodyCount);
+    // Lays out one frame of the view in buffer, which must hold frameBytes(view.size())
+    void packFrame(const PhysicsEngine::StateView& view, std::uint64_t step, double time, char* buffer);
+    // The file header as written to page 0, and the trailer closing the index
+    FileHeader fileHeader();
+    Trailer trailer(std::uint64_t indexOffset, std::uint64_t frameCount);
+}
+
+// Read-only memory mapping of a trajectory file. Frames are views into the
+// mapping: nothing is copied or parsed, and only the pages a caller touches
+// are read from disk.
+class TrajectoryReader {
+public:
+    struct Frame {
+        std::uint64_t step = 0;
+        double time = 0.0;
+        std::size_t bodyCount = 0;
+        const float* columns[TrajectoryFormat::Slot] = {};     // indexed by TrajectoryFormat::Column
+        const std::uint32_t* slots = nullptr;
+        const std::uint32_t* generations = nullptr;
+
+        const float* column(TrajectoryFormat::Column c) const { return columns[c]; }
+        SlotHandle handle(std::size_t i) const { return {slots[i], generations[i]}; }
+    };
+
+    TrajectoryReader() = default;
+    TrajectoryReader(const TrajectoryReader&) = delete;
+    TrajectoryReader& operator=(const TrajectoryReader&) = delete;
+    ~TrajectoryReader();
+
+    bool open(const std::string& filename);
+    void close();
+
+    std::size_t frameCount() const { return frames; }
+    // Frame number index; false if it lies outside the file
+    bool frame(std::size_t index, Frame& out) const;
+    // First frame at or after the given step or time, or frameCount() if there is none
+    std::size_t findStep(std::uint64_t step) const;
+    std::size_t findTime(double time) const;
+    // True if the index was rebuilt because the writer did not finish the file
+    bool recovered() const { return !rebuiltIndex.empty(); }
+
+private:
+    const char* data = nullptr;
+    std::uint64_t size = 0;
+    const TrajectoryFormat::FrameEntry* entries = nullptr;
+    std::size_t frames = 0;
+    std::vector<TrajectoryFormat::FrameEntry> rebuiltIndex;
+
+    bool readIndex();
+    void rebuildIndex();
+};
@@ -0,0 +1,41 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+// Lock-free single-producer single-consumer triple buffer. The writer fills
+// writeBuffer() and publishes it; the reader picks up the newest published
+// buffer with update(). Neither side ever waits for the other: the writer
+// always has a buffer of its own, and the reader keeps its current one until
+// a newer one is complete.
+template <class T>
+class TripleBuffer {
+public:
+    // Writer side: the buffer being filled, never visible to the reader
+    T& writeBuffer() { return buffers[writeIndex]; }
+
+    // Writer side: hands writeBuffer() to the reader and takes the spare one
+    void publish() {
+        writeIndex = state.exchange(static_cast<std::uint8_t>(writeIndex | freshBit), std::memory_order_acq_rel) & indexMask;
+    }
+
+    // Reader side: switches to the newest published buffer, if there is one
+    // the reader has not seen yet. Returns whether it switched.
+    bool update() {
+        if (!(state.load(std::memory_order_relaxed) & freshBit)) return false;
+        readIndex = state.exchange(readIndex, std::memory_order_acq_rel) & indexMask;
+        return true;
+    }
+
+    // Reader side: the buffer picked by the last update()
+    const T& readBuffer() const { return buffers[readIndex]; }
+
+private:
+    static constexpr std::uint8_t indexMask = 3;
+    static constexpr std::uint8_t freshBit = 4;   // spare buffer holds unread data
+
+    T buffers[3];
+    // Each side owns one index; state holds the spare buffer's index
+    alignas(64) std::uint8_t writeIndex = 0;
+    alignas(64) std::uint8_t readIndex = 1;
+    alignas(64) std::atomic<std::uint8_t> state{2};
+};
@@ -0,0 +1,149 @@
+#pragma once
+#include "Ewald.hpp"
+#include "PhysicsEngine.hpp"
+#include "TaskScheduler.hpp"
+#include <cmath>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+// Per-body stages of PhysicsEngine::update. Each stage only touches the body
+// it is given, so any sequence of them can be fused into one sweep over the
+// body array instead of streaming it once per stage.
+namespace UpdateStages {
+    using Body = PhysicsEngine::Body;
+
+    // Nudge orbiting bodies toward a circular orbit around the central body.
+    // The central body is captured by value so it can be drifted in the same sweep.
+    struct OrbitalCorrection {
+        glm::vec3 centerPosition;
+        float centralMass;
+        float gravityConstant;
+
+        void operator()(Body& b, size_t i) const {
+            if (i == 0) return;
+            float currentRadius = glm::length(b.position - centerPosition);
+            float targetVelocity = std::sqrt(gravityConstant * centralMass / currentRadius);
+
+            // Get current velocity direction
+            glm::vec3 currentVel = b.velocity;
+            float currentSpeed = glm::length(currentVel);
+
+            // Calculate tangential direction (perpendicular to radial direction)
+            glm::vec3 radialDir = glm::normalize(b.position - centerPosition);
+            glm::vec3 tangentialDir = glm::vec3(-radialDir.z, 0.0f, radialDir.x); // Perpendicular in XZ plane
+
+            // Adjust velocity to maintain orbital motion
+            if (currentSpeed > 0.1f) {
+                // Gradually adjust toward orbital velocity
+                glm::vec3 targetVel = tangentialDir * targetVelocity;
+                b.velocity = glm::mix(currentVel, targetVel, 0.01f);
+            } else {
+                // If nearly stationary, set initial orbital velocity
+                b.velocity = tangentialDir * targetVelocity;
+            }
+        }
+    };
+
+    // Apply this step's acceleration, constrained to the XZ plane
+    struct Kick {
+        const glm::vec3* accelerations;
+        float dt;
+
+        void operator()(Body& b, size_t i) const {
+            glm::vec3 accel = accelerations[i];
+            accel.y = 0.0f;
+            b.velocity.y = 0.0f;
+            b.velocity += accel * dt;
+        }
+    };
+
+    // Add some damping to prevent chaotic behavior
+    struct Damping {
+        float factor;
+
+        void operator()(Body& b, size_t) const {
+            b.velocity *= factor;
+        }
+    };
+
+    // Keep objects within bounds (prevent them from flying off screen)
+    struct Boundary {
+        float radius;
+
+        void operator()(Body& b, size_t) const {
+            if (glm::length(b.position) > radius) {
+                glm::vec3 direction = glm::normalize(b.position);
+                b.position = direction * radius;
+                // Reverse velocity component away from center
+                float radialVel = glm::dot(b.velocity, direction);
+                if (radialVel > 0) {
+                    b.velocity -= direction * radialVel * 0.5f;
+                }
+            }
+        }
+    };
+
+    // Limit maximum velocity to prevent chaos
+    struct VelocityClamp {
+        float maxVelocity;
+
+        void operator()(Body& b, size_t) const {
+            if (glm::length(b.velocity) > maxVelocity) {
+                b.velocity = glm::normalize(b.velocity) * maxVelocity;
+            }
+        }
+    };
+
+    // Advance positions. Bodies flagged in deferred are skipped and drifted
+    // later, once their collision has been resolved.
+    struct Drift {
+        float dt;
+        const std::uint8_t* deferred = nullptr;
+
+        void operator()(Body& b, size_t i) const {
+            if (deferred && deferred[i]) return;
+            b.position += b.velocity * dt;
+            // Ensure all bodies stay on the XZ plane
+            b.position.y = 0.0f;
+        }
+    };
+
+    // Periodic boundaries: bring drifted bodies back into the box
+    struct PeriodicWrap {
+        float boxSize;
+
+        void operator()(Body& b, size_t) const {
+            b.position = Periodic::wrap(b.position, boxSize);
+        }
+    };
+
+    // Wraps a stage that is compiled out entirely when Enabled is false
+    template <bool Enabled, class Stage>
+    struct Optional {
+        Stage stage;
+
+        void operator()(Body& b, size_t i) const {
+            if constexpr (Enabled) {
+                stage(b, i);
+            }
+        }
+    };
+
+    // Run every stage on each body in [begin, end) before moving to the next body
+    template <class... Stages>
+    void sweep(std::vector<Body>& bodies, size_t begin, size_t end, const Stages&... stages) {
+        for (size_t i = begin; i < end; ++i) {
+            Body& b = bodies[i];
+            (stages(b, i), ...);
+        }
+    }
+
+    // One fused pass over all bodies, split across the scheduler's workers
+    template <class... Stages>
+    void parallelSweep(std::vector<Body>& bodies, const Stages&... stages) {
+        TaskScheduler::instance().parallelFor(bodies.size(), 16384, [&](size_t begin, size_t end) {
+            sweep(bodies, begin, end, stages...);
+        });
+    }
+}
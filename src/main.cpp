@@ -14,6 +14,9 @@ make          # or cmake --build .
 #include "Camera.hpp"
 #include "ConfigLoader.hpp"
 #include "InteractiveGUI.hpp"
+#include "SceneSync.hpp"
+#include "SimulationThread.hpp"
+#include "TaskScheduler.hpp"
 #include <vector>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -30,7 +33,8 @@ int main() {
     
     // Load configuration
     SimulationConfig config = ConfigLoader::loadConfig("../config/simulation.json");
-    bool configChanged = true; // Start with true to initialize physics engine
+    bool configChanged = false; // set by the GUI whenever it edits the config
+    ConfigEdits edits;          // and which objects it touched
     
     Shader shader("../shaders/basic.vs.glsl", "../shaders/basic.fs.glsl"); 
     Shader backgroundShader("../shaders/background.vs.glsl", "../shaders/background.fs.glsl");
@@ -81,29 +85,26 @@ int main() {
     Mesh grid(gridVertices, GL_LINES);
     std::cout << "Grid mesh created with " << gridVertices.size() / 3 << " vertices" << std::endl;
 
-    PhysicsEngine phys;
-    
-    // Function to recreate physics engine when config changes
-    auto recreatePhysicsEngine = [&]() {
-        phys = PhysicsEngine(); // Clear and recreate
-        for (const auto& objConfig : config.objects) {
-            // Calculate orbital velocity for orbiting objects
-            glm::vec3 velocity = objConfig.velocity;
-            if (objConfig.type == "orbiting") {
-                float orbitalRadius = glm::length(objConfig.position);
-                float orbitalVelocity = sqrt(config.physics.gravityConstant * config.objects[0].mass / orbitalRadius) * 0.9f;
-                velocity = glm::vec3(0.0f, 0.0f, orbitalVelocity);
-            }
-            
-            phys.addBody({objConfig.position, velocity, objConfig.mass});
-            std::cout << "Added " << objConfig.name << " at position " 
-                      << objConfig.position.x << ", " << objConfig.position.y << ", " << objConfig.position.z << std::endl;
-        }
-        std::cout << "Recreated physics engine with " << config.objects.size() << " bodies" << std::endl;
+    // Physics runs on its own thread at a fixed timestep, paced by wall time
+    SimulationThread sim(config.physics, 0.016f);
+    SceneSync scene; // patches GUI edits into the running simulation; used on the simulation thread only
+    
+    // Hands the edited objects to the simulation thread, never the whole scene
+    size_t postedObjects = 0;
+    auto applyConfig = [&](const ConfigEdits& changes) {
+        SceneSync::Patch patch = SceneSync::makePatch(config, changes, postedObjects);
+        postedObjects = config.objects.size();
+        sim.post([&scene, &sim, patch = std::move(patch)](PhysicsEngine& engine) {
+            scene.apply(patch, engine);
+            sim.track(scene.getHandles());
+        });
     };
     
-    // Initial creation
-    recreatePhysicsEngine();
+    ConfigEdits initial;
+    initial.allObjects = true;
+    applyConfig(initial);
+    sim.start();
+    std::cout << "Simulating " << config.objects.size() << " bodies" << std::endl;
     
     Camera cam({0, 6, 8}, -90, -45); // Angled view, not directly above
     glfwSetKeyCallback(window, Camera::keyCallback);
@@ -130,15 +131,20 @@ int main() {
     std::cout << "Starting render loop..." << std::endl;
 
     while(!glfwWindowShouldClose(window)) {
-        float dt = 0.016f; // Fixed timestep for stability
-        
-        // Recreate physics engine if config changed
+        // Apply only what the GUI changed; everything else keeps running
         if (configChanged) {
-            recreatePhysicsEngine();
+            applyConfig(edits);
+            edits.clear();
             configChanged = false;
         }
         
-        phys.update(dt);
+        // Newest complete physics state; never waits for a step to finish.
+        // Bodies are drawn between its last two steps, so motion stays smooth
+        // whatever the ratio of frame rate to physics rate.
+        const SimulationThread::Snapshot& state = sim.latest();
+        const float blend = state.blendAt(SimulationThread::Clock::now());
+        sim.setTimeWarp(InteractiveGUI::getTimeWarp());
+        InteractiveGUI::setSimulationRate(state.simRate);
         
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
         
@@ -155,14 +161,15 @@ int main() {
         shader.setUniform("projection", proj);
         shader.setUniform("view", cam.getViewMatrix());
         
-        const auto& bodies = phys.getBodies();
-        for (size_t i = 0; i < bodies.size() && i < config.objects.size(); ++i) {
-            const auto& body = bodies[i];
+        for (size_t i = 0; i < state.tracked.size() && i < config.objects.size(); ++i) {
+            // Bodies merged into another one are gone from the engine
+            std::uint32_t body = state.find(state.tracked[i]);
+            if (body == SlotMap::npos) continue;
             const auto& objConfig = config.objects[i];
             
             // Scale based on mass and configured radius for visual effect
-            float scale = objConfig.radius * 2.0f; // Scale the configured radius
-            glm::mat4 model = glm::translate(glm::mat4(1.0f), body.position);
+            float scale = state.radii[body] * 2.0f; // Grows as bodies merge
+            glm::mat4 model = glm::translate(glm::mat4(1.0f), state.interpolatedPosition(body, blend));
             model = glm::scale(model, glm::vec3(scale));
             
             shader.setUniform("model", model);
@@ -174,12 +181,17 @@ int main() {
         }
         
         // Render Interactive GUI
-        InteractiveGUI::render(config, configChanged);
+        InteractiveGUI::render(config, configChanged, edits);
         
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
     
+    sim.stop();
+    
+    // Report how evenly the physics work was spread over the worker threads
+    TaskScheduler::instance().printStats(std::cout);
+    
     // Cleanup
     InteractiveGUI::shutdown();
     cleanupWindow(window);